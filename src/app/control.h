@@ -72,6 +72,11 @@ enum {
 	FS = 0x1C, // < \ |
 	GS = 0x1D, // = ] }
 	RS = 0x1E, // > ^ ~
+
+	// The terminal brackets text the user pastes with these sequences, so
+	// we can take it in as one piece rather than as a series of keystrokes.
+	PasteBegin = 0x1000, // ESC [ 200 ~
+	PasteEnd = 0x1001, // ESC [ 201 ~
 };
 } // namespace Control
 
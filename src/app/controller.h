@@ -18,6 +18,7 @@
 #ifndef APP_CONTROLLER_H
 #define APP_CONTROLLER_H
 
+#include <functional>
 #include <string>
 #include <vector>
 #include "search/engine.h"
@@ -36,6 +37,9 @@ public:
 	virtual std::string get_clipboard() = 0;
 	virtual void cache_read(std::string name, std::vector<std::string> &lines) = 0;
 	virtual void cache_write(std::string name, const std::vector<std::string> &lines) = 0;
+	// Call the handler whenever this descriptor has input ready.
+	virtual void watch(int fd, std::function<void()> handler) = 0;
+	virtual void unwatch(int fd) = 0;
 };
 
 #endif //APP_CONTROLLER_H
@@ -0,0 +1,276 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "app/keyboard.h"
+#include "app/control.h"
+#include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+const char kEscape = '\033';
+// Sequences longer than this are garbage, not keys; give up on them.
+const size_t kMaxSequence = 32;
+// The end of a bracketed paste.
+const char kPasteEnd[] = "\033[201~";
+
+// Modifier keys, as the terminal reports them once we subtract one.
+enum {
+	kShift = 1,
+	kAlt = 2,
+	kCtrl = 4,
+};
+
+// Keys the terminal reports with CSI or SS3 sequences. Some are identified
+// by the final byte alone; the rest end in '~' and carry a number.
+struct sequence_t {
+	char final;
+	int number;
+	int key;
+};
+const sequence_t kSequences[] = {
+	{'A', 0, KEY_UP},
+	{'B', 0, KEY_DOWN},
+	{'C', 0, KEY_RIGHT},
+	{'D', 0, KEY_LEFT},
+	{'H', 0, KEY_HOME},
+	{'F', 0, KEY_END},
+	{'Z', 0, KEY_BTAB},
+	{'P', 0, KEY_F(1)},
+	{'Q', 0, KEY_F(2)},
+	{'R', 0, KEY_F(3)},
+	{'S', 0, KEY_F(4)},
+	{'~', 1, KEY_HOME},
+	{'~', 2, KEY_IC},
+	{'~', 3, KEY_DC},
+	{'~', 4, KEY_END},
+	{'~', 5, KEY_PPAGE},
+	{'~', 6, KEY_NPAGE},
+	{'~', 7, KEY_HOME},
+	{'~', 8, KEY_END},
+	{'~', 11, KEY_F(1)},
+	{'~', 12, KEY_F(2)},
+	{'~', 13, KEY_F(3)},
+	{'~', 14, KEY_F(4)},
+	{'~', 15, KEY_F(5)},
+	{'~', 17, KEY_F(6)},
+	{'~', 18, KEY_F(7)},
+	{'~', 19, KEY_F(8)},
+	{'~', 20, KEY_F(9)},
+	{'~', 21, KEY_F(10)},
+	{'~', 23, KEY_F(11)},
+	{'~', 24, KEY_F(12)},
+	{'~', 200, Control::PasteBegin},
+	{'~', 201, Control::PasteEnd},
+};
+
+int lookup(char final, int number) {
+	for (auto &seq: kSequences) {
+		if (seq.final != final) continue;
+		if (seq.final == '~' && seq.number != number) continue;
+		return seq.key;
+	}
+	return ERR;
+}
+
+int modify(int key, int mods) {
+	// Control-arrows move by word or jump around; alt-left and alt-right
+	// have their own codes; shift-arrows extend the selection. Other keys
+	// mean the same thing whatever modifiers are held down.
+	switch (key) {
+		case KEY_LEFT:
+			if (mods & kCtrl) return Control::LeftArrow;
+			if (mods & kAlt) return Control::AltLeftArrow;
+			if (mods & kShift) return KEY_SLEFT;
+			break;
+		case KEY_RIGHT:
+			if (mods & kCtrl) return Control::RightArrow;
+			if (mods & kAlt) return Control::AltRightArrow;
+			if (mods & kShift) return KEY_SRIGHT;
+			break;
+		case KEY_UP:
+			if (mods & kCtrl) return Control::UpArrow;
+			if (mods & kShift) return KEY_SR;
+			break;
+		case KEY_DOWN:
+			if (mods & kCtrl) return Control::DownArrow;
+			if (mods & kShift) return KEY_SF;
+			break;
+	}
+	return key;
+}
+
+int control(int code) {
+	// Which control character would a traditional terminal have sent?
+	if (code >= 'a' && code <= 'z') return code & 0x1F;
+	if (code >= '@' && code <= '_') return code & 0x1F;
+	if (code == '/' || code == '?' || code == '7') return 0x1F;
+	return code;
+}
+
+void text(int code, int mods, std::vector<int> &keys) {
+	// An extended report for an ordinary key: translate it back into the
+	// bytes a traditional terminal would have sent.
+	switch (code) {
+		case 0x1B: keys.push_back(Control::Escape); return;
+		case 0x0D: keys.push_back(Control::Return); return;
+		case 0x7F: keys.push_back(Control::Backspace); return;
+		case 0x09: keys.push_back(mods & kShift? KEY_BTAB: Control::Tab); return;
+	}
+	if (mods & kCtrl) code = control(code);
+	if (mods & kAlt) keys.push_back(Control::Escape);
+	if (code < 0x80) {
+		keys.push_back(code);
+		return;
+	}
+	// Characters beyond ASCII arrive as UTF-8, one byte at a time.
+	char buf[4];
+	size_t len = 0;
+	if (code < 0x800) {
+		buf[len++] = 0xC0 | (code >> 6);
+	} else {
+		if (code < 0x10000) {
+			buf[len++] = 0xE0 | (code >> 12);
+		} else {
+			buf[len++] = 0xF0 | (code >> 18);
+			buf[len++] = 0x80 | ((code >> 12) & 0x3F);
+		}
+		buf[len++] = 0x80 | ((code >> 6) & 0x3F);
+	}
+	buf[len++] = 0x80 | (code & 0x3F);
+	for (size_t i = 0; i < len; ++i) {
+		keys.push_back((unsigned char)buf[i]);
+	}
+}
+} // namespace
+
+void Keyboard::decode(const char *buf, size_t len, std::vector<int> &keys) {
+	_input.append(buf, len);
+	size_t pos = 0;
+	while (pos < _input.size()) {
+		if (_pasting) {
+			size_t used = paste(pos, keys);
+			if (0 == used) break;
+			pos += used;
+			continue;
+		}
+		char ch = _input[pos];
+		if (ch == kEscape) {
+			size_t used = escape(pos, keys);
+			if (0 == used) break;
+			pos += used;
+			continue;
+		}
+		// Some terminals send DEL for the backspace key, others BS.
+		keys.push_back(ch == 0x7F? Control::Backspace: (unsigned char)ch);
+		pos++;
+	}
+	_input.erase(0, pos);
+	if (!_pasting && _input.size() == 1 && _input[0] == kEscape) {
+		keys.push_back(Control::Escape);
+		_input.clear();
+	}
+}
+
+size_t Keyboard::escape(size_t pos, std::vector<int> &keys) {
+	// Decode the escape sequence beginning at this position, returning the
+	// number of bytes it contained, or zero if it is not yet complete.
+	size_t end = _input.size();
+	if (pos + 1 == end) return 0;
+	char intro = _input[pos + 1];
+	if (intro == 'O') {
+		// SS3, which carries no parameters; terminals in application mode
+		// use it for the arrows and the first few function keys.
+		if (pos + 2 == end) return 0;
+		int key = lookup(_input[pos + 2], 0);
+		if (key != ERR) keys.push_back(key);
+		return 3;
+	}
+	if (intro != '[') {
+		// An escape which begins no sequence is just the escape key.
+		keys.push_back(Control::Escape);
+		return 1;
+	}
+	size_t i = pos + 2;
+	while (i < end) {
+		unsigned char ch = _input[i];
+		if (ch >= 0x20 && ch <= 0x3F) {
+			i++;
+		} else if (ch >= 0x40 && ch <= 0x7E) {
+			csi(_input.substr(pos + 2, i - pos - 2), ch, keys);
+			return i + 1 - pos;
+		} else {
+			// The sequence was interrupted; drop what we have of it.
+			return i - pos;
+		}
+	}
+	return (end - pos > kMaxSequence)? end - pos: 0;
+}
+
+void Keyboard::csi(const std::string &params, char final, std::vector<int> &keys) {
+	// A private marker means this is some other kind of report, such as a
+	// mouse event, rather than a key.
+	if (!params.empty() && params[0] >= '<' && params[0] <= '?') return;
+	// Parameters are separated by semicolons. Some terminals add details
+	// after a colon, which we don't need.
+	int args[3] = {0, 0, 0};
+	size_t count = 0;
+	const char *p = params.c_str();
+	while (*p && count < 3) {
+		args[count++] = atoi(p);
+		p += strcspn(p, ";");
+		if (*p) p++;
+	}
+	int mods = (args[1] > 0)? args[1] - 1: 0;
+	if (final == 'u') {
+		text(args[0], mods, keys);
+		return;
+	}
+	if (final == '~' && args[0] == 27) {
+		// xterm's modifyOtherKeys puts the modifiers before the key.
+		text(args[2], mods, keys);
+		return;
+	}
+	int key = lookup(final, args[0]);
+	if (key == ERR) return;
+	if (key == Control::PasteBegin) _pasting = true;
+	keys.push_back(modify(key, mods));
+}
+
+size_t Keyboard::paste(size_t pos, std::vector<int> &keys) {
+	// Pasted text is passed along as it is until the closing bracket, which
+	// we must recognize even when it is split across blocks of input.
+	size_t end = _input.find(kPasteEnd, pos);
+	size_t stop = end;
+	if (end == std::string::npos) {
+		stop = _input.size();
+		size_t partial = _input.rfind(kEscape);
+		size_t tail = _input.size() - partial;
+		if (partial != std::string::npos && partial >= pos &&
+				tail < strlen(kPasteEnd) &&
+				0 == _input.compare(partial, tail, kPasteEnd, tail)) {
+			stop = partial;
+		}
+	}
+	for (size_t i = pos; i < stop; ++i) {
+		keys.push_back((unsigned char)_input[i]);
+	}
+	if (end == std::string::npos) return stop - pos;
+	keys.push_back(Control::PasteEnd);
+	_pasting = false;
+	return end + strlen(kPasteEnd) - pos;
+}
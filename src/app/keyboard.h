@@ -0,0 +1,47 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef APP_KEYBOARD_H
+#define APP_KEYBOARD_H
+
+#include <string>
+#include <vector>
+
+// The keyboard decodes the bytes the terminal sends into the keys the rest
+// of the program understands: characters and ASCII controls, curses KEY_
+// codes for the navigation and function keys, and our own Control codes.
+// Escape sequences are parsed as they arrive and looked up in a table, so
+// the meaning of a key does not depend on terminfo, and a sequence resolves
+// as soon as its last byte arrives. Besides the traditional sequences, this
+// understands the extended reports sent by terminals which implement the
+// "CSI u" protocol or xterm's modifyOtherKeys.
+class Keyboard {
+public:
+	// Decode a block of input, appending the keys it contains. A sequence
+	// which runs past the end of the block waits for the next one, except
+	// for a lone escape: terminals send each sequence all at once, so an
+	// escape with nothing after it must be the escape key itself.
+	void decode(const char *buf, size_t len, std::vector<int> &keys);
+private:
+	size_t escape(size_t pos, std::vector<int> &keys);
+	void csi(const std::string &params, char final, std::vector<int> &keys);
+	size_t paste(size_t pos, std::vector<int> &keys);
+	std::string _input;
+	bool _pasting = false;
+};
+
+#endif //APP_KEYBOARD_H
@@ -16,8 +16,10 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <assert.h>
-#include <atomic>
 #include <fstream>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "app/control.h"
@@ -28,12 +30,22 @@
 #include "search/dialog.h"
 #include "search/search.h"
 
-std::atomic_bool sig_io_flag;
+namespace {
+// How long the user must pause before we sync the edit journals to disk.
+const int kJournalSync = 1000;
+} // namespace
 
 Ozette::Ozette():
 		_shell(*this),
 		_home_dir(getenv("HOME")),
-		_cache_dir(_home_dir + "/.ozette") {
+		_cache_dir(_home_dir + "/.ozette"),
+		_frame_budget(16) {
+	// The frame budget may be tuned for slow terminals or remote sessions.
+	const char *budget = getenv("OZETTE_FRAME_MS");
+	if (budget) {
+		_frame_budget = std::chrono::milliseconds(atoi(budget));
+		_report_frames = true;
+	}
 	char *cwd = getcwd(NULL, 0);
 	if (cwd) {
 		_current_dir = cwd;
@@ -122,7 +134,7 @@ void Ozette::cache_write(std::string name, const std::vector<std::string> &l) {
 	}
 	std::ofstream file(_cache_dir + "/" + name, std::ios::trunc);
 	for (auto &line: l) {
-		file << line << std::endl;
+		file << line << '\n';
 	}
 	file.close();
 }
@@ -146,6 +158,7 @@ Ozette::editor Ozette::open_editor(std::string path) {
 	std::unique_ptr<UI::View> edptr(edrec.view);
 	edrec.window = _shell.open_window(std::move(edptr));
 	_editors[path] = edrec;
+	edrec.view->offer_recovery(*edrec.window);
 	return edrec;
 }
 
@@ -161,32 +174,145 @@ void Ozette::search(Search::spec query) {
 	Search::View::exec(query, _shell);
 }
 
+void Ozette::watch(int fd, std::function<void()> handler) {
+	_reactor.watch(fd, handler);
+}
+
+void Ozette::unwatch(int fd) {
+	_reactor.unwatch(fd);
+}
+
 void Ozette::run() {
 	if (_editors.empty()) show_browser();
-	timeout(100);
-	do {
-		if (sig_io_flag.exchange(false)) {
-			_shell.poll();
+	// Sleep until there are keys to read, a background task or subprocess
+	// signals that it has news, or the terminal changes size. Only update
+	// the screen when some window has actually drawn something.
+	_reactor.watch(STDIN_FILENO, [this]() { read_keys(); });
+	_reactor.on_signal(SIGIO, [this]() { _shell.poll(); });
+	_reactor.on_signal(SIGCHLD, [this]() { _shell.poll(); });
+	_reactor.on_signal(SIGWINCH, [this]() { _resize_pending = true; });
+	read_keys();
+	while (!_done) {
+		// Once all the files have been saved, we can start the build.
+		if (_build_pending && !saves_pending()) {
+			_build_pending = false;
+			exec("make");
 		}
-		int ch = fix_control_quirks(getch());
-		switch (ch) {
-			case Control::UpArrow: show_browser(); break;
-			case Control::NewFile: new_file(); break;
-			case Control::Open: open_file(); break;
-			case Control::Directory: change_directory(); break;
-			case Control::Help: show_help(); break;
-			case Control::Execute: execute(); break;
-			case KEY_F(4): search(); break;
-			case KEY_F(5): build(); break;
-			default: _done |= !_shell.process(ch);
+		if (_resize_pending) {
+			_resize_pending = false;
+			resize();
 		}
-		update_panels();
-		doupdate();
-	} while (!_done);
+		if (_shell.take_painted()) {
+			_frames_pending++;
+		}
+		if (_frames_pending && !_frame_scheduled) {
+			present();
+		}
+		if (_done) break;
+		// Write out the edit journals now that this batch of events is done,
+		// then sleep; if nothing happens for a while, sync them to disk.
+		Editor::Journal::write_all();
+		if (!Editor::Journal::unsynced()) {
+			_reactor.wait();
+		} else if (!_reactor.wait(kJournalSync)) {
+			Editor::Journal::sync_all();
+		}
+	}
 }
 
-void Ozette::sig_io() {
-	sig_io_flag.store(true);
+void Ozette::present() {
+	// Show what has been drawn, unless the last frame went out so recently
+	// that this one would exceed the budget; in that case, come back when
+	// the budget allows and show everything drawn until then at once.
+	using namespace std::chrono;
+	auto now = steady_clock::now();
+	auto due = _last_frame + _frame_budget;
+	if (now < due) {
+		// Round up, or we would wake a little early and have to wait again.
+		auto wait = duration_cast<milliseconds>(due - now).count() + 1;
+		_frame_scheduled = true;
+		_reactor.after(wait, [this]() { _frame_scheduled = false; });
+		return;
+	}
+	_dropped_frames += _frames_pending - 1;
+	if (_report_frames && _frames_pending > 1) {
+		// Show the count in this frame, rather than drawing another for it.
+		UI::Window *window = _shell.active();
+		UI::Frame *ctx = window;
+		ctx->show_result(std::to_string(_dropped_frames) + " frames coalesced");
+		window->paint();
+		window->take_painted();
+	}
+	_shell.update();
+	_frames_pending = 0;
+	_last_frame = now;
+}
+
+void Ozette::read_keys() {
+	// Input is edge-triggered, so read until there is nothing left. Then let
+	// the focus window catch up with whatever those keys set in motion.
+	std::vector<int> keys;
+	struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+	while (poll(&input, 1, 0) > 0) {
+		char buf[1024];
+		ssize_t len = read(STDIN_FILENO, buf, sizeof(buf));
+		if (len <= 0) break;
+		_keyboard.decode(buf, len, keys);
+	}
+	for (int ch: keys) {
+		if (_done) break;
+		if (_pasting) {
+			read_paste(ch);
+		} else if (ch == Control::PasteBegin) {
+			_pasting = true;
+		} else {
+			process(ch);
+		}
+	}
+	if (!_done) process(ERR);
+}
+
+void Ozette::read_paste(int ch) {
+	// A paste may take more than one read to arrive, so collect it until the
+	// closing bracket shows up. Terminals send line breaks as carriage
+	// returns; the document wants newlines.
+	if (ch == Control::PasteEnd) {
+		_pasting = false;
+		_paste_cr = false;
+		std::string text;
+		text.swap(_paste);
+		_done |= !_shell.paste(text);
+		return;
+	}
+	if (ch > 0xFF) return;
+	bool after_cr = _paste_cr;
+	_paste_cr = '\r' == ch;
+	if ('\n' == ch && after_cr) return;
+	_paste.push_back(_paste_cr? '\n': (char)ch);
+}
+
+void Ozette::resize() {
+	// The terminal's resize signal comes to us rather than to curses, so we
+	// must tell it about the new size ourselves.
+	struct winsize size;
+	if (0 == ioctl(STDOUT_FILENO, TIOCGWINSZ, &size)) {
+		resizeterm(size.ws_row, size.ws_col);
+	}
+	process(KEY_RESIZE);
+}
+
+void Ozette::process(int ch) {
+	switch (ch) {
+		case Control::UpArrow: show_browser(); break;
+		case Control::NewFile: new_file(); break;
+		case Control::Open: open_file(); break;
+		case Control::Directory: change_directory(); break;
+		case Control::Help: show_help(); break;
+		case Control::Execute: execute(); break;
+		case KEY_F(4): search(); break;
+		case KEY_F(5): build(); break;
+		default: _done |= !_shell.process(ch);
+	}
 }
 
 void Ozette::show_browser() {
@@ -273,11 +399,19 @@ void Ozette::execute() {
 }
 
 void Ozette::build() {
-	// Save all open editors. Execute the build command for this directory.
+	// Save all open editors. Execute the build command for this directory
+	// when they have all been written; the saves happen in the background.
 	for (auto &edit_pair: _editors) {
 		edit_pair.second.window->process(Control::Save);
 	}
-	exec("make");
+	_build_pending = true;
+}
+
+bool Ozette::saves_pending() {
+	for (auto &edit_pair: _editors) {
+		if (edit_pair.second.view->saving()) return true;
+	}
+	return false;
 }
 
 void Ozette::search() {
@@ -286,34 +420,3 @@ void Ozette::search() {
 	Search::Dialog::show(*_shell.active(), job);
 }
 
-int Ozette::fix_control_quirks(int ch) {
-	// Terminals are weird and control keys are complicated.
-	switch (ch) {
-
-	// When the user presses the backspace key, some terminals send us
-	// ASCII BS, others send ASCII DEL, and others send something that
-	// ncurses interprets as KEY_BACKSPACE. We will stick with ASCII BS.
-	case KEY_BACKSPACE:
-	case 0x7F: return Control::Backspace;
-
-	// Different terminals send us different codes for control-left and
-	// control-right arrow. Some terminals send us a different code for
-	// control-left and control-right arrow when the shift key is held
-	// down, while others don't distinguish.
-	case 0x21D:
-	case 0x224:
-	case 0x221:
-	case 0x220: return Control::LeftArrow;
-	case 0x22C:
-	case 0x230:
-	case 0x22F: return Control::RightArrow;
-	case 0x20C:
-	case 0x20D: return Control::DownArrow;
-	case 0x235:
-	case 0x236: return Control::UpArrow;
-
-	default:
-	return ch;
-	}
-}
-
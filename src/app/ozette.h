@@ -18,10 +18,13 @@
 #ifndef APP_OZETTE_H
 #define APP_OZETTE_H
 
+#include <chrono>
 #include <map>
 #include <string>
 #include <vector>
 #include "app/controller.h"
+#include "app/keyboard.h"
+#include "app/reactor.h"
 #include "browser/browser.h"
 #include "editor/editor.h"
 #include "ui/shell.h"
@@ -39,8 +42,9 @@ public:
 	virtual void cache_read(std::string name, std::vector<std::string> &lines) override;
 	virtual void cache_write(std::string name, const std::vector<std::string> &lines) override;
 	virtual void search(Search::spec query) override;
+	virtual void watch(int fd, std::function<void()> handler) override;
+	virtual void unwatch(int fd) override;
 	void run();
-	void sig_io();
 private:
 	struct editor {
 		UI::Window *window;
@@ -53,16 +57,41 @@ private:
 	void show_help();
 	void execute();
 	void build();
+	bool saves_pending();
 	void search();
-	int fix_control_quirks(int ch);
+	void read_keys();
+	void read_paste(int ch);
+	void process(int ch);
+	void resize();
+	void present();
 	void exec(std::string command);
 	editor open_editor(std::string path);
+	Reactor _reactor;
+	Keyboard _keyboard;
 	UI::Shell _shell;
 	std::string _home_dir;
 	std::string _current_dir;
     std::string _cache_dir;
 	std::map<std::string, editor> _editors;
 	std::string _clipboard;
+	bool _build_pending = false;
+	// Text the terminal has bracketed as a paste, as it comes in
+	bool _pasting = false;
+	std::string _paste;
+	bool _paste_cr = false;
+	// The terminal may change size many times while the user drags it; we
+	// only need to lay out the windows for the last one.
+	bool _resize_pending = false;
+	// Frames are shown no more often than the budget allows. Anything drawn
+	// in the meantime waits for the next frame.
+	std::chrono::milliseconds _frame_budget;
+	std::chrono::steady_clock::time_point _last_frame;
+	unsigned _frames_pending = 0;
+	bool _frame_scheduled = false;
+	// How many frames were folded into a later one, rather than being shown;
+	// reported while the budget is being tuned.
+	unsigned long _dropped_frames = 0;
+	bool _report_frames = false;
 	bool _done = false;
 };
 
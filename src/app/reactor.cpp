@@ -0,0 +1,134 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "app/reactor.h"
+#include <errno.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+void add(int epoll, int fd, uint32_t events) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev)) {
+		throw std::runtime_error(strerror(errno));
+	}
+}
+} // namespace
+
+Reactor::Reactor() {
+	sigemptyset(&_signals);
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+	_signalfd = signalfd(-1, &_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (_epoll < 0 || _signalfd < 0 || _timerfd < 0) {
+		throw std::runtime_error(strerror(errno));
+	}
+	add(_epoll, _signalfd, EPOLLIN);
+	add(_epoll, _timerfd, EPOLLIN);
+}
+
+Reactor::~Reactor() {
+	close(_timerfd);
+	close(_signalfd);
+	close(_epoll);
+}
+
+void Reactor::watch(int fd, std::function<void()> handler) {
+	if (!_watches.count(fd)) {
+		add(_epoll, fd, EPOLLIN | EPOLLET);
+	}
+	_watches[fd] = handler;
+}
+
+void Reactor::unwatch(int fd) {
+	if (!_watches.erase(fd)) return;
+	epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Reactor::block(const sigset_t &signals) {
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+void Reactor::on_signal(int signo, std::function<void()> handler) {
+	_signal_handlers[signo] = handler;
+	sigaddset(&_signals, signo);
+	signalfd(_signalfd, &_signals, 0);
+}
+
+void Reactor::after(unsigned msec, std::function<void()> handler) {
+	_timer_handler = handler;
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = msec / 1000;
+	spec.it_value.tv_nsec = (msec % 1000) * 1000000L;
+	// A zero delay would disarm the timer, so round up to a nanosecond.
+	if (0 == msec) spec.it_value.tv_nsec = 1;
+	timerfd_settime(_timerfd, 0, &spec, nullptr);
+}
+
+bool Reactor::wait(int msec) {
+	const int kMaxEvents = 16;
+	struct epoll_event events[kMaxEvents];
+	int count = epoll_wait(_epoll, events, kMaxEvents, msec);
+	for (int i = 0; i < count; ++i) {
+		int fd = events[i].data.fd;
+		if (fd == _signalfd) {
+			read_signals();
+		} else if (fd == _timerfd) {
+			read_timer();
+		} else {
+			// An earlier handler may have stopped watching this descriptor.
+			// A handler may also unwatch itself, so call a copy.
+			auto iter = _watches.find(fd);
+			if (iter == _watches.end()) continue;
+			auto handler = iter->second;
+			handler();
+		}
+	}
+	return count > 0;
+}
+
+void Reactor::read_signals() {
+	// Many signals of one kind may have arrived since we last looked; one
+	// call to the handler is enough for all of them.
+	sigset_t arrived;
+	sigemptyset(&arrived);
+	struct signalfd_siginfo info;
+	while (read(_signalfd, &info, sizeof(info)) == sizeof(info)) {
+		sigaddset(&arrived, info.ssi_signo);
+	}
+	for (auto &entry: _signal_handlers) {
+		if (!sigismember(&arrived, entry.first)) continue;
+		auto handler = entry.second;
+		handler();
+	}
+}
+
+void Reactor::read_timer() {
+	uint64_t expirations;
+	if (read(_timerfd, &expirations, sizeof(expirations)) <= 0) return;
+	std::function<void()> handler;
+	handler.swap(_timer_handler);
+	if (handler) handler();
+}
@@ -0,0 +1,59 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef APP_REACTOR_H
+#define APP_REACTOR_H
+
+#include <functional>
+#include <map>
+#include <signal.h>
+
+// The main loop sleeps in a reactor until something needs attention: input
+// on a descriptor, the arrival of a signal, or the expiry of a timer. Each
+// event source has a handler, which the reactor calls when it is ready.
+class Reactor {
+public:
+	Reactor();
+	~Reactor();
+	// Call the handler when the descriptor has input or has hung up. Events
+	// are edge-triggered, so the handler must read everything available.
+	void watch(int fd, std::function<void()> handler);
+	void unwatch(int fd);
+	// Call the handler when the signal arrives. Signals are delivered through
+	// a descriptor, so they must be blocked in every thread; the caller must
+	// do that with block() before any other thread starts.
+	static void block(const sigset_t &signals);
+	void on_signal(int signo, std::function<void()> handler);
+	// Call the handler once, after some number of milliseconds. There is
+	// only one timer; setting it again replaces any earlier handler.
+	void after(unsigned msec, std::function<void()> handler);
+	// Sleep until at least one event is ready, then dispatch all which are.
+	// With a timeout, give up after that many milliseconds, returning false.
+	bool wait(int msec = -1);
+private:
+	void read_signals();
+	void read_timer();
+	int _epoll = -1;
+	int _signalfd = -1;
+	int _timerfd = -1;
+	sigset_t _signals;
+	std::map<int, std::function<void()>> _watches;
+	std::map<int, std::function<void()>> _signal_handlers;
+	std::function<void()> _timer_handler;
+};
+
+#endif //APP_REACTOR_H
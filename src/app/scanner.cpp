@@ -0,0 +1,247 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "app/scanner.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+void Scanner::add(const std::string &pattern, unsigned id) {
+	size_t pos = 0;
+	Fragment frag = parse_alternation(pattern, pos);
+	if (pos != pattern.size()) {
+		throw std::invalid_argument("unbalanced pattern: " + pattern);
+	}
+	_nfa[frag.out].accept = id;
+	_roots.push_back(frag.in);
+}
+
+void Scanner::compile() {
+	// Each DFA state stands for the set of NFA states we could be in. Begin
+	// with the states we can reach before reading anything, then follow
+	// every possible byte from every state we discover.
+	std::map<std::vector<int>, int> known;
+	auto intern = [this, &known](std::vector<int> &&states) -> int {
+		if (states.empty()) return -1;
+		auto iter = known.find(states);
+		if (iter != known.end()) return iter->second;
+		int index = make_dfa_state(std::vector<int>(states));
+		known[std::move(states)] = index;
+		return index;
+	};
+	std::vector<int> start(_roots);
+	closure(start, false, false);
+	_start = intern(std::move(start));
+	std::vector<int> start_bol(_roots);
+	closure(start_bol, true, false);
+	_start_bol = intern(std::move(start_bol));
+	for (size_t index = 0; index < _dfa.size(); ++index) {
+		for (unsigned ch = 0; ch < 256; ++ch) {
+			std::vector<int> targets;
+			for (int state: _dfa[index].nfa) {
+				if (_nfa[state].set.test(ch)) {
+					targets.push_back(_nfa[state].next);
+				}
+			}
+			closure(targets, false, false);
+			// Careful: interning may reallocate the DFA state list.
+			int next = intern(std::move(targets));
+			_dfa[index].next[ch] = next;
+		}
+	}
+	// We won't need the NFA again.
+	for (auto &state: _dfa) {
+		state.nfa.clear();
+	}
+	_nfa.clear();
+}
+
+size_t Scanner::match(const std::string &text, size_t pos, unsigned &id) const {
+	size_t length = 0;
+	id = kNone;
+	int state = (pos == 0)? _start_bol: _start;
+	for (size_t i = pos; state >= 0; ++i) {
+		const DState &dstate = _dfa[state];
+		unsigned accept = (i == text.size())? dstate.accept_eol: dstate.accept;
+		if (accept != kNone && i > pos) {
+			length = i - pos;
+			id = accept;
+		}
+		if (i == text.size()) break;
+		state = dstate.next[static_cast<unsigned char>(text[i])];
+	}
+	return length;
+}
+
+Scanner::Fragment Scanner::parse_alternation(
+		const std::string &pattern, size_t &pos) {
+	Fragment frag = parse_sequence(pattern, pos);
+	while (pos < pattern.size() && pattern[pos] == '|') {
+		++pos;
+		Fragment alt = parse_sequence(pattern, pos);
+		Fragment both{make_state(), make_state()};
+		_nfa[both.in].empty = {frag.in, alt.in};
+		_nfa[frag.out].empty.push_back(both.out);
+		_nfa[alt.out].empty.push_back(both.out);
+		frag = both;
+	}
+	return frag;
+}
+
+Scanner::Fragment Scanner::parse_sequence(
+		const std::string &pattern, size_t &pos) {
+	int in = make_state();
+	Fragment frag{in, in};
+	while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')') {
+		Fragment next = parse_repetition(pattern, pos);
+		_nfa[frag.out].empty.push_back(next.in);
+		frag.out = next.out;
+	}
+	return frag;
+}
+
+Scanner::Fragment Scanner::parse_repetition(
+		const std::string &pattern, size_t &pos) {
+	Fragment frag = parse_atom(pattern, pos);
+	while (pos < pattern.size()) {
+		char op = pattern[pos];
+		if (op != '*' && op != '+' && op != '?') break;
+		++pos;
+		Fragment rep{make_state(), make_state()};
+		_nfa[rep.in].empty.push_back(frag.in);
+		_nfa[frag.out].empty.push_back(rep.out);
+		if (op != '+') _nfa[rep.in].empty.push_back(rep.out);
+		if (op != '?') _nfa[frag.out].empty.push_back(frag.in);
+		frag = rep;
+	}
+	return frag;
+}
+
+Scanner::Fragment Scanner::parse_atom(const std::string &pattern, size_t &pos) {
+	Fragment frag{make_state(), make_state()};
+	char ch = pattern[pos++];
+	switch (ch) {
+		case '(': {
+			frag = parse_alternation(pattern, pos);
+			if (pos >= pattern.size() || pattern[pos] != ')') {
+				throw std::invalid_argument("unbalanced pattern: " + pattern);
+			}
+			++pos;
+		} break;
+		case '[': {
+			--pos;
+			frag = parse_bracket(pattern, pos);
+		} break;
+		case '.': {
+			_nfa[frag.in].set.set();
+			_nfa[frag.in].next = frag.out;
+		} break;
+		case '^': {
+			_nfa[frag.in].bol.push_back(frag.out);
+		} break;
+		case '$': {
+			_nfa[frag.in].eol.push_back(frag.out);
+		} break;
+		case '\\': {
+			if (pos < pattern.size()) ch = pattern[pos++];
+		} // fall through
+		default: {
+			_nfa[frag.in].set.set(static_cast<unsigned char>(ch));
+			_nfa[frag.in].next = frag.out;
+		}
+	}
+	return frag;
+}
+
+Scanner::Fragment Scanner::parse_bracket(
+		const std::string &pattern, size_t &pos) {
+	// As in POSIX, a backslash is an ordinary character inside a bracket
+	// expression, and a ']' at the beginning is a member, not the end.
+	++pos;
+	bool negate = pos < pattern.size() && pattern[pos] == '^';
+	if (negate) ++pos;
+	std::bitset<256> set;
+	size_t begin = pos;
+	while (pos < pattern.size() && (pattern[pos] != ']' || pos == begin)) {
+		unsigned char lo = pattern[pos++];
+		unsigned char hi = lo;
+		if (pos + 1 < pattern.size() && pattern[pos] == '-' &&
+				pattern[pos + 1] != ']') {
+			hi = pattern[pos + 1];
+			pos += 2;
+		}
+		for (unsigned ch = lo; ch <= hi; ++ch) {
+			set.set(ch);
+		}
+	}
+	if (pos >= pattern.size()) {
+		throw std::invalid_argument("unbalanced pattern: " + pattern);
+	}
+	++pos;
+	if (negate) set.flip();
+	Fragment frag{make_state(), make_state()};
+	_nfa[frag.in].set = set;
+	_nfa[frag.in].next = frag.out;
+	return frag;
+}
+
+int Scanner::make_state() {
+	_nfa.emplace_back();
+	return _nfa.size() - 1;
+}
+
+void Scanner::closure(std::vector<int> &states, bool bol, bool eol) const {
+	// Add every state we can reach without consuming any input. We keep
+	// only the states which can consume input, accept a match, or wait for
+	// the end of the line, since the others don't affect the DFA, which then
+	// has fewer distinct states.
+	std::vector<bool> seen(_nfa.size());
+	std::vector<int> work(states);
+	states.clear();
+	while (!work.empty()) {
+		int state = work.back();
+		work.pop_back();
+		if (seen[state]) continue;
+		seen[state] = true;
+		const NState &nstate = _nfa[state];
+		if (nstate.next >= 0 || nstate.accept != kNone || !nstate.eol.empty()) {
+			states.push_back(state);
+		}
+		work.insert(work.end(), nstate.empty.begin(), nstate.empty.end());
+		if (bol) work.insert(work.end(), nstate.bol.begin(), nstate.bol.end());
+		if (eol) work.insert(work.end(), nstate.eol.begin(), nstate.eol.end());
+	}
+	std::sort(states.begin(), states.end());
+}
+
+int Scanner::make_dfa_state(std::vector<int> &&states) {
+	DState dstate;
+	dstate.next.fill(-1);
+	for (int state: states) {
+		dstate.accept = std::min(dstate.accept, _nfa[state].accept);
+	}
+	// Which matches could we accept if the line ended here? That includes
+	// any which are waiting on a '$'.
+	std::vector<int> eol(states);
+	closure(eol, false, true);
+	for (int state: eol) {
+		dstate.accept_eol = std::min(dstate.accept_eol, _nfa[state].accept);
+	}
+	dstate.nfa = std::move(states);
+	_dfa.push_back(std::move(dstate));
+	return _dfa.size() - 1;
+}
@@ -0,0 +1,86 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef APP_SCANNER_H
+#define APP_SCANNER_H
+
+#include <array>
+#include <bitset>
+#include <climits>
+#include <string>
+#include <vector>
+
+// A scanner matches a set of patterns all at once, using a DFA compiled from
+// all of them together, so finding the next token takes a single pass over
+// the text no matter how many patterns there are. Patterns use the subset of
+// POSIX extended regular expression syntax our grammars need: literals and
+// escaped literals, '.', bracket expressions, groups, alternation, the '*',
+// '+', and '?' operators, and the '^' and '$' anchors, which match at the
+// beginning and end of the line.
+class Scanner {
+public:
+	static const unsigned kNone = UINT_MAX;
+	// Add a pattern; if the longest match is matched by more than one
+	// pattern, the lowest id wins.
+	void add(const std::string &pattern, unsigned id);
+	// Build the DFA; no more patterns may be added afterward.
+	void compile();
+	// Find the longest match for any pattern beginning at this position.
+	// Returns its length, or zero if there is no match.
+	size_t match(const std::string &text, size_t pos, unsigned &id) const;
+private:
+	struct Fragment {
+		int in;
+		int out;
+	};
+	Fragment parse_alternation(const std::string &pattern, size_t &pos);
+	Fragment parse_sequence(const std::string &pattern, size_t &pos);
+	Fragment parse_repetition(const std::string &pattern, size_t &pos);
+	Fragment parse_atom(const std::string &pattern, size_t &pos);
+	Fragment parse_bracket(const std::string &pattern, size_t &pos);
+	int make_state();
+	void closure(std::vector<int> &states, bool bol, bool eol) const;
+	int make_dfa_state(std::vector<int> &&states);
+	// The NFA, built from the patterns with Thompson's construction. Each
+	// state may consume one byte from its set, and may also move on without
+	// consuming anything, either unconditionally or at the line's edges.
+	struct NState {
+		std::bitset<256> set;
+		int next = -1;
+		std::vector<int> empty;
+		std::vector<int> bol;
+		std::vector<int> eol;
+		unsigned accept = kNone;
+	};
+	std::vector<NState> _nfa;
+	std::vector<int> _roots;
+	// The DFA, built from the NFA by subset construction. Matching at the
+	// beginning of the line starts from a different state, since '^' is only
+	// satisfied there; at the end of the line, '$' may let us accept a match
+	// we would not otherwise accept.
+	struct DState {
+		std::vector<int> nfa;
+		std::array<int, 256> next;
+		unsigned accept = kNone;
+		unsigned accept_eol = kNone;
+	};
+	std::vector<DState> _dfa;
+	int _start = -1;
+	int _start_bol = -1;
+};
+
+#endif //APP_SCANNER_H
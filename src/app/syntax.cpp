@@ -17,8 +17,8 @@
 
 #include "app/syntax.h"
 #include "ui/colors.h"
+#include <cctype>
 #include <map>
-#include <sstream>
 
 namespace Syntax {
 
@@ -29,8 +29,8 @@ const Rule cident{"[A-Za-z_][A-Za-z0-9_]*", Token::Type::Identifier};
 const Rule cnumber{"(0([Xx][0-9A-Fa-f]+)?)|([1-9]+)", Token::Type::Literal};
 const Rule slashcomment{"//(.*)$", Token::Type::Comment};
 const Rule hashcomment{"#(.*)$", Token::Type::Comment};
-
-// Keyword lists must be alphabetized.
+const Rule blockcomment{"/\\*", "*/", Token::Type::Comment};
+const Rule rawstring{"`", "`", Token::Type::String};
 
 const Grammar generic = {
 };
@@ -45,7 +45,7 @@ const Grammar c = {
 		"_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary", "_Noreturn",
 		"_Static_assert", "_Thread_local"
 	}),
-	cpreproc, strdq, strsq, cident, cnumber, slashcomment,
+	cpreproc, strdq, strsq, cident, cnumber, slashcomment, blockcomment,
 };
 
 const Grammar cxx = {
@@ -64,7 +64,8 @@ const Grammar cxx = {
 		"typeid", "typename", "union", "unsigned", "using", "virtual", "void",
 		"volatile", "wchar_t", "while", "xor", "xor_eq"
 	}),
-	cpreproc, strdq, strsq, cident, cnumber, slashcomment,
+	cpreproc, strdq, strsq, cident, cnumber, slashcomment, blockcomment,
+	{"R\"\\(", ")\"", Token::Type::String},
 };
 
 const Grammar ruby = {
@@ -98,6 +99,8 @@ const Grammar python = {
 		"with", "yield", "yield from",
 	}),
 	strdq, strsq, cident, cnumber, hashcomment,
+	{"\"\"\"", "\"\"\"", Token::Type::String},
+	{"'''", "'''", Token::Type::String},
 };
 
 const Grammar js = {
@@ -108,7 +111,7 @@ const Grammar js = {
 		"new", "return", "super", "switch", "this", "throw", "try", "typeof",
 		"var", "void", "while", "with", "yield",
 	}),
-	strdq, strsq, cident, cnumber, slashcomment,
+	strdq, strsq, cident, cnumber, slashcomment, blockcomment, rawstring,
 };
 
 const Grammar protobuf = {
@@ -120,7 +123,7 @@ const Grammar protobuf = {
 		// types: bool float double string bytes int32 int64 sint32 sint64
 		//        uint64 fixed32 fixed64 sfixed32 sfixed64
 	}),
-	strdq, strsq, cident, cnumber, slashcomment,
+	strdq, strsq, cident, cnumber, slashcomment, blockcomment,
 };
 
 const Grammar golang = {
@@ -130,7 +133,7 @@ const Grammar golang = {
 		"import", "interface", "iota", "map", "nil", "package", "range",
 		"return", "select", "struct", "switch", "true", "type", "var",
 	}),
-	strdq, strsq, cident, cnumber, slashcomment,
+	strdq, strsq, cident, cnumber, slashcomment, blockcomment, rawstring,
 };
 
 const std::map<std::string, const Grammar&> extensions = {
@@ -163,37 +166,142 @@ int Token::style() const {
 }
 
 Rule Rule::keywords(std::list<std::string> words) {
-	std::stringstream buf;
-	std::string delim;
-	buf << "\\<(";
-	for (auto &word: words) {
-		buf << word << delim;
-		delim = "|";
+	Rule out("", Token::Type::Keyword);
+	out.words.assign(words.begin(), words.end());
+	return out;
+}
+
+static bool is_word_char(char ch) {
+	return isalnum(static_cast<unsigned char>(ch)) || ch == '_';
+}
+
+Grammar::Grammar(std::initializer_list<Rule> rules):
+		_rules(rules) {
+	unsigned index = 0;
+	for (auto &rule: _rules) {
+		++index;
+		_has_blocks |= !rule.close.empty();
+		if (!rule.pattern.empty()) {
+			_scanner.add(rule.pattern, index);
+		}
+		if (rule.words.empty()) continue;
+		// Add each word to the trie, one character at a time.
+		_keyword_rule = index;
+		if (_trie.empty()) _trie.push_back(Node{0, false, -1, -1});
+		for (auto &word: rule.words) {
+			int node = 0;
+			for (char ch: word) {
+				int next = _trie[node].child;
+				while (next >= 0 && _trie[next].ch != ch) {
+					next = _trie[next].sibling;
+				}
+				if (next < 0) {
+					next = _trie.size();
+					_trie.push_back(Node{ch, false, -1, _trie[node].child});
+					_trie[node].child = next;
+				}
+				node = next;
+			}
+			_trie[node].word = true;
+		}
 	}
-	buf << ")\\>";
-	return Rule(buf.str(), Token::Type::Keyword);
+	_scanner.compile();
 }
 
-Tokens Syntax::parse(const Grammar &prods, const std::string &text) {
-	Tokens out;
-	for (size_t pos = 0; pos != std::string::npos;) {
-		Token tk{std::string::npos, std::string::npos};
-		for (auto &prod: prods) {
-			auto match = prod.pattern.find(text, pos);
-			if (match.empty()) continue;
-			if (match.begin > tk.begin) continue;
-			if (match.begin == tk.begin && match.end <= tk.end) continue;
-			tk.begin = match.begin;
-			tk.end = match.end;
-			tk.type = prod.token;
+unsigned Grammar::match(const std::string &text, size_t pos, Token &tk) const {
+	for (; pos < text.size(); ++pos) {
+		unsigned id = 0;
+		size_t length = _scanner.match(text, pos, id);
+		// A keyword must begin and end on a word boundary.
+		if (_keyword_rule && (pos == 0 || !is_word_char(text[pos - 1]))) {
+			size_t keylen = match_keyword(text, pos);
+			bool longer = keylen > length;
+			bool earlier = keylen == length && _keyword_rule < id;
+			if (keylen > 0 && (longer || earlier)) {
+				length = keylen;
+				id = _keyword_rule;
+			}
+		}
+		if (length == 0) continue;
+		tk.begin = pos;
+		tk.end = pos + length;
+		tk.type = rule(id).token;
+		return id;
+	}
+	return 0;
+}
+
+size_t Grammar::match_keyword(const std::string &text, size_t pos) const {
+	// Walk down the trie as far as the text lets us, remembering the longest
+	// word we pass which ends on a word boundary.
+	size_t length = 0;
+	int node = 0;
+	for (size_t i = pos; i < text.size(); ++i) {
+		node = _trie[node].child;
+		while (node >= 0 && _trie[node].ch != text[i]) {
+			node = _trie[node].sibling;
 		}
-		if (tk.begin == tk.end) break;
-		out.push_back(tk);
+		if (node < 0) break;
+		if (!_trie[node].word) continue;
+		bool boundary = i + 1 == text.size() || !is_word_char(text[i + 1]);
+		if (boundary && is_word_char(text[i])) {
+			length = i + 1 - pos;
+		}
+	}
+	return length;
+}
+
+static void lex(
+		const Grammar &grammar,
+		const std::string &text,
+		State &state,
+		Tokens *out) {
+	size_t pos = 0;
+	// If the line begins inside a block, the block continues until its
+	// closing text, or through the whole line if it doesn't close here.
+	if (state) {
+		const Rule &rule = grammar.rule(state);
+		size_t close = text.find(rule.close);
+		pos = (close != std::string::npos)? close + rule.close.size(): text.size();
+		if (out && pos > 0) out->push_back(Token{0, pos, rule.token});
+		if (close == std::string::npos) return;
+		state = 0;
+	}
+	Token tk;
+	while (unsigned found = grammar.match(text, pos, tk)) {
+		// A block token extends to the end of the block; if the block does
+		// not close on this line, the next line will begin inside it.
+		const Rule &rule = grammar.rule(found);
+		if (!rule.close.empty()) {
+			size_t close = text.find(rule.close, tk.end);
+			if (close != std::string::npos) {
+				tk.end = close + rule.close.size();
+			} else {
+				tk.end = text.size();
+				state = found;
+			}
+		}
+		if (out) out->push_back(tk);
 		pos = tk.end;
 	}
+}
+
+Tokens Syntax::parse(const Grammar &grammar, const std::string &text, State &state) {
+	Tokens out;
+	lex(grammar, text, state, &out);
 	return out;
 }
 
+State Syntax::scan(const Grammar &grammar, const std::string &text, State state) {
+	// A line which begins inside a block and does not contain the text that
+	// closes it must also end inside the block.
+	if (state && text.find(grammar.rule(state).close) == std::string::npos) {
+		return state;
+	}
+	lex(grammar, text, state, nullptr);
+	return state;
+}
+
 const Grammar &Syntax::lookup(const std::string &path) {
 	std::string ext;
 	size_t dotpos = path.find_last_of('.');
@@ -18,9 +18,11 @@
 #ifndef APP_SYNTAX_H
 #define APP_SYNTAX_H
 
-#include "app/regex.h"
+#include "app/scanner.h"
+#include <initializer_list>
 #include <string>
 #include <list>
+#include <vector>
 
 namespace Syntax {
 
@@ -40,15 +42,55 @@ struct Token {
 typedef std::list<Token> Tokens;
 
 struct Rule {
-	Rule(const char *p, Token::Type t): pattern(std::string(p)), token(t) {}
+	Rule(const char *p, Token::Type t): pattern(p), token(t) {}
 	Rule(const std::string &p, Token::Type t): pattern(p), token(t) {}
+	// A block rule begins with its pattern and continues until the closing
+	// text, which may not appear until some later line.
+	Rule(const char *p, const char *c, Token::Type t):
+			pattern(p), close(c), token(t) {}
+	// A keyword rule matches any of its words, when they stand alone.
 	static Rule keywords(std::list<std::string>);
-	Regex pattern;
+	std::string pattern;
+	std::string close;
+	std::vector<std::string> words;
 	Token::Type token;
 };
-typedef std::list<Rule> Grammar;
 
-Tokens parse(const Grammar&, const std::string&);
+// A grammar compiles its rules into a scanner which matches all of the
+// patterns at once, and a trie which matches all of the keywords at once.
+class Grammar {
+public:
+	Grammar(std::initializer_list<Rule> rules);
+	const Rule &rule(unsigned index) const { return _rules[index - 1]; }
+	bool has_blocks() const { return _has_blocks; }
+	// Find the leftmost, longest token beginning at or after this position;
+	// if more than one rule matches it, the first rule wins. Returns the
+	// one-based index of the rule which matched, or zero if nothing did.
+	unsigned match(const std::string &text, size_t pos, Token &tk) const;
+private:
+	size_t match_keyword(const std::string &text, size_t pos) const;
+	std::vector<Rule> _rules;
+	Scanner _scanner;
+	bool _has_blocks = false;
+	// Keywords live in a trie whose nodes are stored in one vector. Each
+	// node links to its first child and to its next sibling.
+	struct Node {
+		char ch;
+		bool word;
+		int child;
+		int sibling;
+	};
+	std::vector<Node> _trie;
+	unsigned _keyword_rule = 0;
+};
+
+// Each line begins in some state: zero, if it begins normally, or else the
+// one-based index of the block rule whose block it begins inside. Parsing a
+// line updates the state to the one the next line will begin in; scanning
+// computes the same result, but takes shortcuts where it can.
+typedef unsigned State;
+Tokens parse(const Grammar&, const std::string&, State &state);
+State scan(const Grammar&, const std::string&, State state);
 const Grammar &lookup(const std::string &path);
 
 } // namespace Syntax
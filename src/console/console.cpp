@@ -32,6 +32,7 @@ void Console::View::exec(
 		_instance = new Console::View;
 		std::unique_ptr<UI::View> view(_instance);
 		_instance->_window = shell.open_window(std::move(view));
+		_instance->_app = &static_cast<UI::Frame*>(_instance->_window)->app();
 	}
 	_instance->exec(title, exe, argv);
 }
@@ -70,7 +71,7 @@ bool Console::View::poll(UI::Frame &ctx) {
 		ctx.repaint();
 	}
 	if (!_proc->poll()) {
-		_proc.reset(nullptr);
+		close_proc();
 	}
 	set_title(ctx);
 	return true;
@@ -85,6 +86,7 @@ Console::View::View() {
 }
 
 Console::View::~View() {
+	close_proc();
 	_instance = nullptr;
 }
 
@@ -93,9 +95,16 @@ void Console::View::paint_into(WINDOW *view, State state) {
 	wmove(view, 0, 0);
 	getmaxyx(view, _height, _width);
 	_log->layout(_width);
+	// Only rows which scrolled into view, or which show lines the log has
+	// read since the last paint, need to be drawn. The last line may have
+	// grown since then, so it is drawn again too.
+	auto dirty = scroll_to(view, state, _scrollpos);
+	size_t fresh = _painted_lines;
+	_painted_lines = _log->size();
 	for (int row = 0; row < _height; ++row) {
-		wmove(view, row, 0);
 		size_t i = row + _scrollpos;
+		if (!dirty[row] && i < fresh) continue;
+		wmove(view, row, 0);
 		// Sub one to create a blank leading line
 		if (i > 0 && i <= _log->size()) {
 			waddnstr(view, (*_log)[i-1].c_str(), _width);
@@ -118,15 +127,30 @@ void Console::View::exec(
 		argv[i++] = arg.c_str();
 	}
 	argv[i] = nullptr;
+	close_proc();
 	_proc.reset(new Subproc(exe.c_str(), argv));
 	delete[] argv;
+	// Read the subprocess' output as soon as it arrives.
+	UI::Window *window = _window;
+	_app->watch(_proc->out_fd(), [window]() { window->poll(); });
+	_app->watch(_proc->err_fd(), [window]() { window->poll(); });
 	_scrollpos = 0;
 	_log.reset(new Log(title, _width));
+	_painted_lines = 0;
+	forget_rows();
+}
+
+void Console::View::close_proc() {
+	// Stop listening to the subprocess before its pipes are closed.
+	if (!_proc.get()) return;
+	_app->unwatch(_proc->out_fd());
+	_app->unwatch(_proc->err_fd());
+	_proc.reset(nullptr);
 }
 
 void Console::View::ctl_kill(UI::Frame &ctx) {
 	if (_proc.get()) {
-		_proc.reset(nullptr);
+		close_proc();
 		ctx.repaint();
 	}
 }
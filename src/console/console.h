@@ -49,6 +49,7 @@ private:
 			std::string title,
 			const std::string &exe,
 			const std::vector<std::string> &argv);
+	void close_proc();
 	void ctl_kill(UI::Frame &ctx);
 	void key_up(UI::Frame &ctx);
 	void key_down(UI::Frame &ctx);
@@ -56,9 +57,12 @@ private:
 	void key_page_down(UI::Frame &ctx);
 	void set_title(UI::Frame &ctx);
 	unsigned maxscroll() const;
+	Controller *_app = nullptr;
 	std::unique_ptr<Subproc> _proc;
 	std::unique_ptr<Log> _log;
 	unsigned _scrollpos = 0;
+	// How many lines did the log hold when it was last painted?
+	size_t _painted_lines = 0;
 	int _height = 0;
 	int _width = 0;
 };
@@ -15,6 +15,7 @@
  */
 
 #include "console/popenRWE.h"
+#include <signal.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <cstdlib>
@@ -59,6 +60,11 @@ int popenRWE(int *rwepipe, const char *exe, const char *const argv[])
 		close(2);
 		dup(err[1]);
 
+		// Don't pass along the signals our parent has blocked.
+		sigset_t none;
+		sigemptyset(&none);
+		sigprocmask(SIG_SETMASK, &none, NULL);
+
 		execvp(exe, (char**)argv);
 		exit(1);
 	} else
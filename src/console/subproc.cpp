@@ -27,13 +27,11 @@
 Console::Subproc::Subproc(const char *exe, const char **argv) {
 	_pid = popenRWE(_rwepipe, exe, argv);
 	if (_pid > 0) {
-		int ourpid = getpid();
 		for (unsigned i = 0; i <= 2; ++i) {
 			int fd = _rwepipe[i];
-			assert(-1 != fcntl(fd, F_SETOWN, ourpid));
 			int fl = fcntl(fd, F_GETFL);
 			assert(fl >= 0);
-			assert(-1 != fcntl(fd, F_SETFL, fl | O_ASYNC | O_NONBLOCK));
+			assert(-1 != fcntl(fd, F_SETFL, fl | O_NONBLOCK));
 		}
 	}
 }
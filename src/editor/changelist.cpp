@@ -18,53 +18,61 @@
 #include "editor/changelist.h"
 #include "editor/document.h"
 #include <assert.h>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+// Text shorter than this gains nothing from compression.
+const size_t kMinCompress = 256;
+} // namespace
 
 void Editor::ChangeList::clear() {
-	while (!_done.empty()) _done.pop();
-	while (!_undone.empty()) _undone.pop();
+	_done.clear();
+	_undone.clear();
+	_sealed = 0;
 	_committed = false;
 }
 
 void Editor::ChangeList::erase(const Range &loc, std::string text) {
-	while(!_undone.empty()) _undone.pop();
+	while (!_undone.empty()) drop(_undone);
 	assert(!loc.empty());
 	if (combine_erase(loc, text)) return;
 	change_t temp;
 	temp.erase = true;
 	temp.eraseloc = loc;
 	temp.erasetext = text;
-	_done.push(temp);
+	push(std::move(temp));
 	_committed = false;
 }
 
 void Editor::ChangeList::insert(const Range &loc) {
-	while(!_undone.empty()) _undone.pop();
+	while (!_undone.empty()) drop(_undone);
 	assert(!loc.empty());
 	if (combine_insert(loc)) return;
 	change_t temp;
 	temp.insert = true;
 	temp.insertloc = loc;
-	_done.push(temp);
+	push(std::move(temp));
 	_committed = false;
 }
 
 void Editor::ChangeList::split(location_t loc) {
-	while(!_undone.empty()) _undone.pop();
+	while (!_undone.empty()) drop(_undone);
 	if (combine_split(loc)) return;
 	change_t temp;
 	temp.split = true;
 	temp.splitloc = loc;
-	_done.push(temp);
+	push(std::move(temp));
 	_committed = false;
 }
 
-Editor::location_t Editor::ChangeList::undo(Document &doc, Update &update) {
+Editor::location_t Editor::ChangeList::undo(Document &doc) {
 	if (_done.empty()) return location_t();
-	std::stack<change_t> undone = std::move(_undone);
+	std::deque<change_t> undone = std::move(_undone);
+	_undone.clear();
 	// Remove the last change from the done list, then reverse its effect.
-	change_t temp = _done.top();
-	_done.pop();
-	location_t out = temp.rollback(doc, update);
+	change_t temp = pop(_done);
+	location_t out = temp.rollback(doc);
 	// Reversing the effect of the last change is a new change, which will go
 	// onto the undo stack. That's great but this is really the inverse of a
 	// change, so we will pop it off the "done" stack and put it onto the
@@ -72,37 +80,83 @@ Editor::location_t Editor::ChangeList::undo(Document &doc, Update &update) {
 	// action. We can undo the undo by invoking "redo". This is how we get to
 	// have multilevel undo.
 	_undone = std::move(undone);
-	_undone.push(_done.top());
-	_done.pop();
+	change_t inverse = pop(_done);
+	inverse.seal();
+	_sealed += inverse.footprint();
+	_undone.push_back(std::move(inverse));
 	_committed = true;
+	trim();
 	return out;
 }
 
-Editor::location_t Editor::ChangeList::redo(Document &doc, Update &update) {
+Editor::location_t Editor::ChangeList::redo(Document &doc) {
 	if (_undone.empty()) return location_t();
 	// Remove the most recent change from the undone list, then reverse its
 	// effect. This will re-implement whatever the original change was, which
 	// will push a new action onto the _done list, effectively transferring the
 	// change from the "undone" list to the "done" list.
-	change_t temp = _undone.top();
-	_undone.pop();
-	std::stack<change_t> undone = std::move(_undone);
-	location_t out = temp.rollback(doc, update);
+	change_t temp = pop(_undone);
+	std::deque<change_t> undone = std::move(_undone);
+	_undone.clear();
+	location_t out = temp.rollback(doc);
 	_undone = std::move(undone);
 	_committed = true;
 	return out;
 }
 
 void Editor::ChangeList::commit() {
-	while (!_undone.empty()) _undone.pop();
+	while (!_undone.empty()) drop(_undone);
 	if (_done.empty()) return;
 	_committed = true;
 }
 
+void Editor::ChangeList::set_budget(size_t bytes) {
+	_budget = bytes;
+	trim();
+}
+
+size_t Editor::ChangeList::memory() const {
+	// Sealed changes are already counted; the latest may still be growing.
+	size_t out = _sealed;
+	if (!_done.empty() && !_done.back().sealed) {
+		out += _done.back().footprint();
+	}
+	return out;
+}
+
+void Editor::ChangeList::push(change_t &&change) {
+	if (!_done.empty() && !_done.back().sealed) {
+		_done.back().seal();
+		_sealed += _done.back().footprint();
+	}
+	_done.push_back(std::move(change));
+	trim();
+}
+
+Editor::ChangeList::change_t Editor::ChangeList::pop(std::deque<change_t> &changes) {
+	change_t out = std::move(changes.back());
+	changes.pop_back();
+	if (out.sealed) _sealed -= out.footprint();
+	return out;
+}
+
+void Editor::ChangeList::drop(std::deque<change_t> &changes) {
+	// Forget the change at the bottom of the stack.
+	if (changes.front().sealed) _sealed -= changes.front().footprint();
+	changes.pop_front();
+}
+
+void Editor::ChangeList::trim() {
+	// Forget the oldest changes first, then the changes we would redo last.
+	while (memory() > _budget && _done.size() > 1) drop(_done);
+	while (memory() > _budget && !_undone.empty()) drop(_undone);
+}
+
 bool Editor::ChangeList::combine_erase(const Range &loc, std::string text) {
 	if (_done.empty()) return false;
-	auto &top = _done.top();
+	auto &top = _done.back();
 	if (_committed) return false;
+	if (top.sealed) return false;
 	if (top.split) return false;
 	if (top.insert) return false;
 	if (top.erase) {
@@ -129,8 +183,9 @@ bool Editor::ChangeList::combine_erase(const Range &loc, std::string text) {
 
 bool Editor::ChangeList::combine_insert(const Range &loc) {
 	if (_done.empty()) return false;
-	auto &top = _done.top();
+	auto &top = _done.back();
 	if (_committed) return false;
+	if (top.sealed) return false;
 	if (top.split) return false;
 	if (top.insert) {
 		// The topmost change already includes an insert. If this insert
@@ -151,22 +206,40 @@ bool Editor::ChangeList::combine_split(location_t loc) {
 	// Try to combine this split with the topmost change. If we cannot combine,
 	// return false so the caller knows it's time for a new change record.
 	if (_done.empty()) return false;
-	auto &top = _done.top();
+	auto &top = _done.back();
 	if (_committed) return false;
+	if (top.sealed) return false;
 	if (top.split) return false;
 	top.split = true;
 	top.splitloc = loc;
 	return true;
 }
 
-Editor::location_t Editor::ChangeList::change_t::rollback(
-		Document &doc, Update &update) {
+void Editor::ChangeList::change_t::seal() {
+	sealed = true;
+	if (erasetext.size() < kMinCompress) return;
+	uLongf size = compressBound(erasetext.size());
+	std::string packed(size, '\0');
+	int err = compress2(reinterpret_cast<Bytef*>(&packed[0]), &size,
+			reinterpret_cast<const Bytef*>(erasetext.data()),
+			erasetext.size(), Z_BEST_SPEED);
+	if (Z_OK != err || size >= erasetext.size()) return;
+	packed.resize(size);
+	packed.shrink_to_fit();
+	erasesize = erasetext.size();
+	erasetext.swap(packed);
+}
+
+size_t Editor::ChangeList::change_t::footprint() const {
+	return sizeof(change_t) + erasetext.capacity();
+}
+
+Editor::location_t Editor::ChangeList::change_t::rollback(Document &doc) {
 	location_t out;
 	if (split) {
 		// We inserted a linebreak at the splitloc. Delete it.
 		Range span(splitloc, doc.next_char(splitloc));
 		doc.erase(span);
-		update.range(span);
 		out = splitloc;
 	}
 	if (insert) {
@@ -174,22 +247,23 @@ Editor::location_t Editor::ChangeList::change_t::rollback(
 		// insertloc. Delete that text.
 		doc.erase(insertloc);
 		out = insertloc.begin();
-		if (insertloc.multiline()) {
-			update.forward(out);
-		} else {
-			update.range(insertloc);
-		}
 	}
 	if (erase) {
 		// We erased some text, which was at the range specified by eraseloc,
-		// and which we have saved as erasetext. Re-insert it at the beginning
-		// of the eraseloc.
-		doc.insert(eraseloc.begin(), erasetext);
-		if (eraseloc.multiline()) {
-			update.forward(eraseloc.begin());
-		} else {
-			update.range(eraseloc);
+		// and which we have saved as erasetext, compressed if erasesize is
+		// nonzero. Re-insert it at the beginning of the eraseloc.
+		std::string text = erasetext;
+		if (erasesize) {
+			text.resize(erasesize);
+			uLongf size = erasesize;
+			int err = uncompress(reinterpret_cast<Bytef*>(&text[0]), &size,
+					reinterpret_cast<const Bytef*>(erasetext.data()),
+					erasetext.size());
+			if (Z_OK != err || size != erasesize) {
+				throw std::runtime_error("undo history is corrupt");
+			}
 		}
+		doc.insert(eraseloc.begin(), text);
 		out = eraseloc.end();
 	}
 	return out;
@@ -18,10 +18,9 @@
 #ifndef EDITOR_CHANGELIST_H
 #define EDITOR_CHANGELIST_H
 
+#include <deque>
 #include <string>
-#include <stack>
 #include "editor/coordinates.h"
-#include "editor/update.h"
 
 namespace Editor {
 class Document;
@@ -35,31 +34,48 @@ public:
 	void split(location_t loc);
 	// Roll back the last change, or re-apply the most recently undone change.
 	// Return value is the new cursor position.
-	location_t undo(Document &doc, Update &update);
-	location_t redo(Document &doc, Update &update);
+	location_t undo(Document &doc);
+	location_t redo(Document &doc);
 	// If we have undone some actions, forget them, because we are committing
 	// to the current state and beginning a new edit.
 	void commit();
 	// Can we currently undo or redo an action?
 	bool can_undo() const { return !_done.empty(); }
 	bool can_redo() const { return !_undone.empty(); }
+	// The oldest changes are forgotten once the history uses more memory
+	// than its budget allows, though the latest change is always kept.
+	void set_budget(size_t bytes);
+	size_t depth() const { return _done.size(); }
+	size_t memory() const;
 private:
 	bool combine_erase(const Range &loc, std::string text);
 	bool combine_insert(const Range &loc);
 	bool combine_split(location_t loc);
 	struct change_t {
-		location_t rollback(Document &doc, Update &update);
+		location_t rollback(Document &doc);
+		// Once a change is no longer the latest, it will not grow any more,
+		// so we compress its text and account for its memory.
+		void seal();
+		size_t footprint() const;
+		bool sealed = false;
 		bool erase = false;
 		Range eraseloc;
 		std::string erasetext;
+		size_t erasesize = 0;
 		bool insert = false;
 		Range insertloc;
 		bool split = false;
 		location_t splitloc;
 	};
-	std::stack<change_t> _done;
-	std::stack<change_t> _undone;
+	void push(change_t &&change);
+	change_t pop(std::deque<change_t> &changes);
+	void drop(std::deque<change_t> &changes);
+	void trim();
+	std::deque<change_t> _done;
+	std::deque<change_t> _undone;
 	bool _committed = false;
+	size_t _budget = 64 * 1024 * 1024;
+	size_t _sealed = 0;
 };
 } // namespace Editor
 
@@ -0,0 +1,136 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/columns.h"
+#include <algorithm>
+#include <string.h>
+#include "unicode/unicode.h"
+
+namespace {
+// A line this short is quicker to measure than to sample.
+const size_t kBlock = 256;
+// We only need maps for the few lines the cursor and selection touch.
+const size_t kLimit = 8;
+} // namespace
+
+Editor::ColumnCache::ColumnCache(const Document &doc, const Config &config):
+		_doc(doc),
+		_config(config) {
+}
+
+Editor::column_t Editor::ColumnCache::column(line_t index, offset_t offset) {
+	Map &map = lookup(index);
+	if (map.simple) return std::min(offset, map.size);
+	// Start from the last sample at or before the offset.
+	auto iter = std::upper_bound(
+			map.samples.begin(), map.samples.end(), offset,
+			[](offset_t off, const Sample &s) { return off < s.offset; });
+	--iter;
+	offset_t pos = iter->offset;
+	column_t col = iter->column;
+	const Line &text = _doc.line(index);
+	while (pos < offset && pos < text.size()) {
+		pos = advance(text, pos, col);
+	}
+	return col;
+}
+
+Editor::offset_t Editor::ColumnCache::offset(line_t index, column_t h) {
+	Map &map = lookup(index);
+	if (map.simple) return std::min((offset_t)h, map.size);
+	// Start from the last sample at or before the column.
+	auto iter = std::upper_bound(
+			map.samples.begin(), map.samples.end(), h,
+			[](column_t col, const Sample &s) { return col < s.column; });
+	--iter;
+	offset_t pos = iter->offset;
+	column_t col = iter->column;
+	const Line &text = _doc.line(index);
+	while (pos < text.size()) {
+		column_t next_col = col;
+		offset_t next = advance(text, pos, next_col);
+		if (next_col > h) break;
+		pos = next;
+		col = next_col;
+	}
+	return pos;
+}
+
+void Editor::ColumnCache::lines_changed(
+		line_t index, line_t removed, line_t added) {
+	// Forget the lines which changed and renumber the lines after them.
+	for (auto iter = _maps.begin(); iter != _maps.end();) {
+		if (iter->index >= index && iter->index < index + removed) {
+			iter = _maps.erase(iter);
+			continue;
+		}
+		if (iter->index >= index + removed) {
+			iter->index = iter->index - removed + added;
+		}
+		++iter;
+	}
+}
+
+Editor::ColumnCache::Map &Editor::ColumnCache::lookup(line_t index) {
+	// Tabs in every map were measured with the old indent size.
+	if (_indent_size != _config.indent_size()) {
+		_indent_size = _config.indent_size();
+		_maps.clear();
+	}
+	for (auto iter = _maps.begin(); iter != _maps.end(); ++iter) {
+		if (iter->index != index) continue;
+		if (iter != _maps.begin()) {
+			std::rotate(_maps.begin(), iter, iter + 1);
+		}
+		return _maps.front();
+	}
+	if (_maps.size() >= kLimit) _maps.pop_back();
+	_maps.insert(_maps.begin(), Map());
+	Map &map = _maps.front();
+	const Line &text = _doc.line(index);
+	map.index = index;
+	map.size = text.size();
+	map.simple = Unicode::ascii(text.data(), text.size()) &&
+			!memchr(text.data(), '\t', text.size());
+	if (!map.simple) {
+		offset_t pos = 0;
+		column_t col = 0;
+		offset_t next_sample = 0;
+		while (pos < text.size()) {
+			if (pos >= next_sample) {
+				map.samples.push_back(Sample{pos, col});
+				next_sample = pos + kBlock;
+			}
+			pos = advance(text, pos, col);
+		}
+		map.samples.push_back(Sample{pos, col});
+	}
+	return map;
+}
+
+Editor::offset_t Editor::ColumnCache::advance(
+		const Line &text, offset_t pos, column_t &col) const {
+	if (text[pos] == '\t') {
+		++col;
+		col += (_config.indent_size() - col % _config.indent_size());
+		return pos + 1;
+	}
+	unsigned width;
+	pos = Unicode::next_cluster(text.data(), text.size(), pos, &width);
+	col += width;
+	return pos;
+}
@@ -0,0 +1,66 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_COLUMNS_H
+#define EDITOR_COLUMNS_H
+
+#include <vector>
+#include "editor/config.h"
+#include "editor/document.h"
+
+namespace Editor {
+// The column cache maps between byte offsets and screen columns for the
+// lines the cursor and selection are on, so that moving around a very long
+// line doesn't mean measuring the whole line every time. Each map samples
+// the column every so many bytes; a lookup starts from the nearest sample.
+// Lines of plain ASCII without tabs need no samples, since each byte takes
+// up exactly one column. The cache watches the document so it can forget
+// about lines which have been edited, and starts over if the config is
+// reloaded with a different indent size.
+class ColumnCache : public Document::Observer {
+public:
+	ColumnCache(const Document &doc, const Config &config);
+	// On which screen column does the character at this offset appear?
+	column_t column(line_t index, offset_t offset);
+	// Where is the last character on the line which begins at or before
+	// this column? The end of the line counts as a character.
+	offset_t offset(line_t index, column_t h);
+	virtual void lines_changed(
+			line_t index, line_t removed, line_t added) override;
+private:
+	struct Sample {
+		offset_t offset;
+		column_t column;
+	};
+	struct Map {
+		line_t index;
+		size_t size;
+		bool simple;
+		std::vector<Sample> samples;
+	};
+	Map &lookup(line_t index);
+	offset_t advance(const Line &text, offset_t pos, column_t &col) const;
+	const Document &_doc;
+	const Config &_config;
+	// Most recently used first.
+	std::vector<Map> _maps;
+	// The indent size the maps were measured with.
+	unsigned _indent_size = 0;
+};
+} // namespace Editor
+
+#endif // EDITOR_COLUMNS_H
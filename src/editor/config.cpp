@@ -176,6 +176,13 @@ void Editor::Config::reset() {
 	_trim_trailing_whitespace = true;
 	_insert_final_newline = true;
 	_max_line_length = 80;
+	// Extension: sync the file, but not its directory, before replacing the
+	// old version of the file.
+	_durability = Durability::File;
+	// Extension: search directories by scanning every file.
+	_search_index = false;
+	// Extension: keep up to 64 MiB of undo history for each file.
+	_undo_memory = 64 * 1024 * 1024;
 }
 
 void Editor::Config::apply(std::string key, std::string val) {
@@ -204,6 +211,16 @@ void Editor::Config::apply(std::string key, std::string val) {
 		else if (val == "false") _insert_final_newline = false;
 	} else if (key == "max_line_length") {
 		_max_line_length = std::stoul(val, 0, 10);
+	} else if (key == "ozette_durability") {
+		if (val == "none") _durability = Durability::None;
+		else if (val == "file") _durability = Durability::File;
+		else if (val == "full") _durability = Durability::Full;
+	} else if (key == "ozette_search_index") {
+		if (val == "true") _search_index = true;
+		else if (val == "false") _search_index = false;
+	} else if (key == "ozette_undo_memory") {
+		// measured in mebibytes
+		_undo_memory = std::stoul(val, 0, 10) * 1024 * 1024;
 	}
 }
 
@@ -19,6 +19,7 @@
 #define EDITOR_CONFIG_H
 
 #include <string>
+#include "editor/writer.h"
 
 // This is an implementation of the editorconfig standard:
 //     http://www.editorconfig.org/
@@ -32,6 +33,12 @@ public:
 	// Properties which control behaviors that this editor actually implements:
 	char indent_style() const { return _indent_style; }
 	unsigned indent_size() const { return _indent_size; }
+	// Not part of the standard: how carefully should we save the file?
+	Durability durability() const { return _durability; }
+	// Also not standard: should searches in this tree keep a trigram index?
+	bool search_index() const { return _search_index; }
+	// Also not standard: how much memory may the undo history use?
+	size_t undo_memory() const { return _undo_memory; }
 	// Other properties are supported, as per the standard, but have no effect.
 private:
 	void reset();
@@ -44,6 +51,9 @@ private:
 	bool _trim_trailing_whitespace;
 	bool _insert_final_newline;
 	unsigned _max_line_length;
+	Durability _durability;
+	bool _search_index;
+	size_t _undo_memory;
 };
 } // namespace Editor
 
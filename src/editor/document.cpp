@@ -16,12 +16,73 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include "editor/document.h"
+#include "unicode/unicode.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <exception>
-#include <fstream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <assert.h>
+#include <signal.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Break a file's bytes into lines, using LF as the delimiter. When reading a
+// Windows formatted text file, we will leave the trailing CR out of each line.
+// We scan the file a block at a time, keeping track of where the next line
+// begins separately from how far we have looked, so a line which straddles
+// the boundary between blocks will be picked up by a later scan.
+class LineScanner {
+public:
+	LineScanner(const char *begin, const char *end):
+			_text(begin), _scan(begin), _end(end) {}
+	bool done() const { return _scan >= _end; }
+	void next(size_t blocksize, std::vector<Editor::Line> &out) {
+		size_t length = std::min(blocksize, (size_t)(_end - _scan));
+		const char *block_end = _scan + length;
+		_breaks.clear();
+		Editor::Mapping::find_linebreaks(_scan, block_end, _breaks);
+		for (const char *eol: _breaks) {
+			add_line(eol, out);
+		}
+		_scan = block_end;
+		// The last line of the file may have no linebreak of its own.
+		if (done() && _text < _end) add_line(_end, out);
+	}
+private:
+	void add_line(const char *eol, std::vector<Editor::Line> &out) {
+		size_t size = eol - _text;
+		if (size > 0 && _text[size - 1] == '\x0D') size--;
+		out.emplace_back(_text, size);
+		_text = eol + 1;
+	}
+	const char *_text;
+	const char *_scan;
+	const char *_end;
+	std::vector<const char*> _breaks;
+};
+} // namespace
+
+// Big files are indexed in the background, so the editor can show the
+// beginning of the file right away. The worker finds linebreaks a block at a
+// time and passes each batch of lines back to the document, which adds them
+// to the end of its rope whenever it gets a chance.
+struct Editor::Document::Indexer {
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<std::vector<Line>> batches;
+	bool done = false;
+	std::atomic_bool cancel;
+};
+
+Editor::Document::Document() {
+	append_line(std::string());
+}
 
 Editor::Document::Document(std::string path) {
 	_lines.clear();
@@ -31,7 +92,6 @@ Editor::Document::Document(std::string path) {
 	struct stat sb;
 	if (stat(path.c_str(), &sb)) {
 		_status = "New";
-		_maxline = append_line("");
 	} else if (S_ISDIR(sb.st_mode)) {
 		_status = "Directory!";
 		_read_only = true;
@@ -40,34 +100,121 @@ Editor::Document::Document(std::string path) {
 		_read_only = true;
 	} else {
 		_status.clear();
+		// Map the file into memory. The lines will refer directly to its
+		// bytes until somebody edits them, so opening even a very large file
+		// costs little more than finding its linebreaks.
+		_original = std::make_shared<Mapping>(path);
+		index_lines(_original->data(), _original->end());
 	}
+	if (_lines.empty()) {
+		append_line(std::string());
+	}
+	_maxline = _lines.size() - 1;
+}
 
-	std::string str;
-	std::ifstream file(path);
-	// We will read every file using LF as delimiter. When reading a Windows
-	// formatted text file, we will then strip the trailing CR.
-	while (std::getline(file, str, '\x0A')) {
-		if (str.back() == '\x0D') str.pop_back();
-		_maxline = append_line(str);
+Editor::Document::~Document() {
+	if (!_indexer) return;
+	_indexer->cancel.store(true);
+	_indexer->worker.join();
+}
+
+std::string Editor::Document::status() const {
+	std::string out = _status;
+	// If another program truncated the file while we had it mapped, the
+	// unedited lines past its new end have lost their text.
+	if (_original && !_original->intact()) {
+		if (!out.empty()) out.push_back(' ');
+		out += "Truncated on disk!";
 	}
+	if (!_indexer) return out;
+	if (!out.empty()) out.push_back(' ');
+	return out + "Indexing " + std::to_string(_maxline + 1) + "+ lines";
 }
 
-void Editor::Document::Write(std::string path) {
-	std::ofstream file;
-	file.exceptions(std::ios::failbit);
-	try {
-		file.open(path, std::ios::trunc | std::ios::out);
-		for (auto &line: _lines) {
-			file << line << std::endl;
+bool Editor::Document::poll() {
+	// Collect any lines the indexer has found since we last checked.
+	if (!_indexer) return false;
+	std::deque<std::vector<Line>> batches;
+	bool done = false;
+	{
+		std::lock_guard<std::mutex> lock(_indexer->mutex);
+		batches.swap(_indexer->batches);
+		done = _indexer->done;
+	}
+	line_t oldsize = _lines.size();
+	for (auto &batch: batches) {
+		_lines.append(std::move(batch));
+	}
+	_maxline = _lines.size() - 1;
+	if (_lines.size() > oldsize) {
+		changed(oldsize, 0, _lines.size() - oldsize);
+	}
+	if (done) {
+		_indexer->worker.join();
+		_indexer.reset();
+	}
+	return done || !batches.empty();
+}
+
+void Editor::Document::wait_for(line_t index) {
+	// Someone wants a line we may not have found yet. Wait for the indexer
+	// to deliver batches until it either reaches that line or runs out.
+	while (_indexer && index > _maxline) {
+		{
+			std::unique_lock<std::mutex> lock(_indexer->mutex);
+			Indexer &ix = *_indexer;
+			ix.ready.wait(lock, [&ix]{ return ix.done || !ix.batches.empty(); });
 		}
-		file.close();
+		poll();
+	}
+}
+
+void Editor::Document::Write(std::string path, Durability durability) {
+	wait_for(SIZE_MAX);
+	Writer file(path, durability, _original.get());
+	_lines.scan(0, _lines.size(), [&file](const Line &line) {
+		file.write(line);
+	});
+	file.commit();
+	clear_modify();
+	if (_journal) _journal->rebase(_journal->mark());
+}
+
+std::shared_ptr<Editor::Document::Snapshot> Editor::Document::snapshot() {
+	wait_for(SIZE_MAX);
+	std::shared_ptr<Snapshot> snap(new Snapshot);
+	snap->lines = _lines;
+	snap->original = _original;
+	snap->generation = _generation;
+	snap->journal = _journal? _journal->mark(): 0;
+	return snap;
+}
+
+void Editor::Document::saved(const Snapshot &snap) {
+	if (snap.generation == _generation) {
 		clear_modify();
-	} catch (...) {
-		int local_errno = errno;
-		std::string err = "Failed to write (" + std::to_string(local_errno);
-		err += ": " + std::string(std::strerror(local_errno)) + ")";
-		throw std::runtime_error(err);
 	}
+	if (_journal) _journal->rebase(snap.journal);
+}
+
+void Editor::Document::journal(std::string path) {
+	if (_journal) _journal->discard();
+	_journal.reset(new Journal(path));
+}
+
+void Editor::Document::replay(const std::vector<Journal::edit_t> &edits) {
+	for (auto &edit: edits) {
+		switch (edit.op) {
+			case Journal::edit_t::Erase: erase(edit.span); break;
+			case Journal::edit_t::Insert: insert(edit.span.begin(), edit.text); break;
+			case Journal::edit_t::Split: split(edit.span.begin()); break;
+		}
+	}
+	commit();
+}
+
+void Editor::Document::discard_journal() {
+	if (_journal) _journal->discard();
 }
 
 Editor::location_t Editor::Document::home() {
@@ -79,34 +226,25 @@ Editor::location_t Editor::Document::end() {
 }
 
 Editor::location_t Editor::Document::home(line_t index) {
+	wait_for(index);
 	location_t loc = {std::min(index, _maxline), 0};
 	return loc;
 }
 
 Editor::location_t Editor::Document::end(line_t index) {
 	if (index > _maxline) index = _maxline;
-	assert(index < _lines.size());
 	location_t loc = {index, _lines[index].size()};
 	return loc;
 }
 
 Editor::location_t Editor::Document::next_char(location_t loc) {
-	const std::string &text = _lines[loc.line];
-	if (loc.offset == text.size()) {
+	const Line &text = _lines[loc.line];
+	if (loc.offset >= text.size()) {
 		return (loc.line < _maxline)? home(loc.line + 1): end();
 	}
-	// If this char begins a multibyte sequence, attempt to consume the number
-	// of continuation bytes which ought to follow it.
-	char ch = text[loc.offset++];
-	unsigned continuations = 0;
-	if (0xC0 == (0xE0 & ch)) continuations = 1;
-	if (0xE0 == (0xF0 & ch)) continuations = 2;
-	if (0xF0 == (0xF8 & ch)) continuations = 3;
-	if (0xF8 == (0xFC & ch)) continuations = 4;
-	if (0xFC == (0xFE & ch)) continuations = 5;
-	while (continuations-- && (0x80 == (text[loc.offset] & 0xC0))) {
-		loc.offset++;
-	}
+	// Move past the whole grapheme cluster, so that a character and its
+	// combining marks, or an emoji sequence, act as a single character.
+	loc.offset = Unicode::next_cluster(text.data(), text.size(), loc.offset);
 	return loc;
 }
 
@@ -114,90 +252,19 @@ Editor::location_t Editor::Document::prev_char(location_t loc) {
 	if (0 == loc.offset) {
 		return (loc.line > 0)? end(loc.line - 1): home();
 	}
-	// If this byte is a continuation, scan backward until we find a byte which
-	// could be the beginning of a character sequence. If this continuation
-	// byte could feasibly serve as a member of that sequence, jump back to the
-	// beginning of the sequence; otherwise return it on its own, since it is
-	// an erroneous character encoding.
-	const std::string &text = _lines[loc.line];
-	offset_t scan = --loc.offset;
-	while (0x80 == (text[scan] & 0xC0)) {
-		--scan;
-	}
-	char ch = text[scan];
-	switch (loc.offset - scan) {
-		case 1: if (0xC0 == (0xE0 & ch)) loc.offset = scan; break;
-		case 2: if (0xE0 == (0xF0 & ch)) loc.offset = scan; break;
-		case 3: if (0xF0 == (0xF8 & ch)) loc.offset = scan; break;
-	}
+	const Line &text = _lines[loc.line];
+	loc.offset = Unicode::prev_cluster(text.data(), text.size(), loc.offset);
 	return loc;
 }
 
-Editor::Range Editor::Document::find(std::string needle, location_t loc) {
-	do {
-		loc.offset = _lines[loc.line].find(needle, loc.offset);
-		if (loc.offset != std::string::npos) {
-			location_t match = {loc.line, loc.offset + needle.size()};
-			return Range(loc, sanitize(match));
-		}
-		loc.offset = 0;
-	} while (loc.line++ < _maxline);
-	return Range(end(), end());
-}
-
-const std::string &Editor::Document::line(line_t index) const {
+const Editor::Line &Editor::Document::line(line_t index) const {
 	return index < _lines.size()? _lines[index]: _blank;
 }
 
 char32_t Editor::Document::codepoint(location_t loc) const {
-	auto iter = _lines[loc.line].begin() + loc.offset;
-	char ch = *iter;
-	// we assume shorter sequences occur more frequently, and we'll do a quick
-	// exit for the most common case, which is a 7-bit ASCII character.
-	if (0 == (ch & 0x80)) {
-		return ch;
-	}
-	// Any byte with its high bit set must be part of a multi-byte sequence
-	// followed by some number of continuation bytes.
-	const char32_t replacement_character = 0xFFFD;
-	char32_t out = 0;
-	unsigned continuations = 0;
-	unsigned minimum = 0;
-	if ((ch & 0xE0) == 0xC0) { // two bytes
-		out = ch & 0x1F;
-		continuations = 1;
-		minimum = 0x80;
-	} else if ((ch & 0xF0) == 0xE0) { // three bytes
-		out = ch & 0x0F;
-		continuations = 2;
-		minimum = 0x800;
-	} else if ((ch & 0xF8) == 0xF0) { // four bytes
-		out = ch & 0x07;
-		continuations = 3;
-		minimum = 0x10000;
-	} else if ((ch & 0xFC) == 0xF8) {
-		out = ch & 0x03;
-		continuations = 2;
-		minimum = 0x200000;
-	} else if ((ch & 0xFE) == 0xFC) {
-		out = ch & 0x01;
-		continuations = 2;
-		minimum = 0x4000000;
-	} else {
-		// all other leading bytes are illegal: it's either an overlong sequence
-		// (5 or 6 bytes) or it's an out-of-place continuation character.
-		return replacement_character;
-	}
-	// Look for the continuation characters we expect and decode the full
-	// character value.
-	while (continuations--) {
-		ch = *++iter;
-		// detect broken sequences with too few continuation bytes
-		if ((ch & 0xC0) != 0x80) return replacement_character;
-		out = (out << 6) | (ch & 0x3F);
-	}
-	// guard against overlong sequences and undefined characters
-	return (out >= minimum && out <= 0x10FFFF)? out: replacement_character;
+	const Line &text = _lines[loc.line];
+	if (loc.offset >= text.size()) return 0;
+	return Unicode::decode(text.data(), text.size(), loc.offset);
 }
 
 std::string Editor::Document::text(const Range &span) const {
@@ -207,7 +274,7 @@ std::string Editor::Document::text(const Range &span) const {
 	std::string chunk = substr_to_end(loc);
 	while (loc.line < end.line) {
 		out << chunk << '\n';
-		chunk = _lines[++loc.line];
+		chunk = _lines[++loc.line].str();
 		loc.offset = 0;
 	}
 	out << chunk.substr(0, end.offset - loc.offset);
@@ -217,15 +284,18 @@ std::string Editor::Document::text(const Range &span) const {
 Editor::location_t Editor::Document::erase(const Range &chars) {
 	if (_lines.empty()) return home();
 	if (!attempt_modify()) return chars.begin();
-	_edits.erase(chars, text(chars));
 	location_t begin = sanitize(chars.begin());
-	std::string prefix = substr_from_home(begin);
 	location_t end = sanitize(chars.end());
+	_edits.erase(Range(begin, end), text(Range(begin, end)));
+	if (_journal) _journal->erase(Range(begin, end));
+	std::string prefix = substr_from_home(begin);
 	std::string suffix = substr_to_end(end);
 	size_t index = begin.line;
-	auto beginter = _lines.begin();
-	_lines.erase(beginter + begin.line + 1, beginter + end.line + 1);
+	_lines.erase(begin.line + 1, end.line + 1);
 	_maxline = _lines.size() - 1;
+	if (end.line > index) {
+		changed(index + 1, end.line - index, 0);
+	}
 	update_line(index, prefix + suffix);
 	return location_t(index, prefix.size());
 }
@@ -235,7 +305,7 @@ Editor::location_t Editor::Document::insert(location_t begin, char ch) {
 	location_t loc = begin;
 	if (!attempt_modify()) return loc;
 	if (loc.line < _lines.size()) {
-		std::string text = _lines[loc.line];
+		std::string text = _lines[loc.line].str();
 		text.insert(loc.offset, 1, ch);
 		update_line(loc.line, text);
 		loc.offset++;
@@ -244,6 +314,7 @@ Editor::location_t Editor::Document::insert(location_t begin, char ch) {
 		loc.offset = 1;
 	}
 	_edits.insert(Range(begin, loc));
+	if (_journal) _journal->insert(begin, std::string(1, ch));
 	return loc;
 }
 
@@ -252,38 +323,41 @@ Editor::location_t Editor::Document::insert(location_t cur, std::string text) {
 	location_t loc = cur;
 	if (!attempt_modify()) return loc;
 
-	std::string suffix;
-	if (loc.line < _lines.size()) {
-		// Split this line apart around the insertion point. We will insert
-		// the new text in between these halves. We will temporarily delete
-		// the suffix from its line, since we're likely to be appending more
-		// text for a while, but we'll append the suffix back on at the end.
-		suffix = substr_to_end(loc);
-		update_line(loc.line, substr_from_home(loc));
-	} else {
-		loc.line = append_line(std::string());
-	}
-
-	// Search the text for linebreaks. Every time we find one, we'll
-	// cut all the chars from our search position to the linebreak and
-	// append them to the current line. Then we'll insert a new, blank
-	// line, which will become the new current line. When we're
-	// finally out of linebreaks, we'll concatenate whatever is left
-	// of the text with our original suffix and append that to the
-	// current line. If there were no linebreaks at all, this will
-	// simply be the original line we started on.
+	// Split this line apart around the insertion point. We will insert the
+	// new text in between these halves.
+	std::string prefix = substr_from_home(loc);
+	std::string suffix = substr_to_end(loc);
+
+	// Search the text for linebreaks. Every time we find one, we'll cut all
+	// the chars from our search position to the linebreak and make a new line
+	// out of them, the first of which begins with the original prefix. When
+	// we're finally out of linebreaks, we'll concatenate whatever is left of
+	// the text with our original suffix to make the last line. If there were
+	// no linebreaks at all, this will simply be the original line we started
+	// on. The new lines all go into the document in a single operation, so a
+	// big paste costs no more than a small one.
+	std::vector<Line> added;
 	size_t startoff = 0, endoff = 0;
 	while ((endoff = text.find('\n', startoff)) != std::string::npos) {
-		append_to_line(loc.line++, text.substr(startoff, endoff-startoff));
-		insert_line(loc.line, "");
-		loc.offset = 0;
+		prefix.append(text, startoff, endoff - startoff);
+		added.emplace_back(std::move(prefix));
+		prefix.clear();
 		startoff = endoff + 1;
 	}
-
-	append_to_line(loc.line, text.substr(startoff, endoff));
-	loc.offset = _lines[loc.line].size();
-	append_to_line(loc.line, suffix);
+	prefix.append(text, startoff, std::string::npos);
+	loc.offset = prefix.size();
+	prefix.append(suffix);
+	added.emplace_back(std::move(prefix));
+
+	_lines.set(loc.line, std::move(added.front()));
+	added.erase(added.begin());
+	loc.line += added.size();
+	line_t count = added.size();
+	_lines.insert(cur.line + 1, std::move(added));
+	_maxline = _lines.size() - 1;
+	changed(cur.line, 1, 1 + count);
 	_edits.insert(Range(cur, loc));
+	if (_journal) _journal->insert(cur, text);
 	return loc;
 }
 
@@ -291,7 +365,8 @@ Editor::location_t Editor::Document::split(location_t loc) {
 	if (!attempt_modify()) return loc;
 	sanitize(&loc);
 	_edits.split(loc);
-	std::string text = line(loc.line);
+	if (_journal) _journal->split(loc);
+	const Line text = line(loc.line);
 	update_line(loc.line, text.substr(0, loc.offset));
 	loc.line++;
 	insert_line(loc.line, text.substr(loc.offset, std::string::npos));
@@ -304,40 +379,84 @@ std::string Editor::Document::substr_from_home(const location_t &loc) {
 }
 
 std::string Editor::Document::substr_to_end(const location_t &loc) const {
-	std::string text = _lines[loc.line];
-	return text.substr(std::min(text.size(), loc.offset), std::string::npos);
+	return _lines[loc.line].substr(loc.offset, std::string::npos);
 }
 
 void Editor::Document::update_line(line_t index, std::string text) {
 	if (index < _lines.size()) {
-		_lines[index] = text;
+		_lines.set(index, Line(std::move(text)));
+		changed(index, 1, 1);
 	} else {
-		_lines.emplace_back(text);
+		_lines.append(Line(std::move(text)));
+		changed(_lines.size() - 1, 0, 1);
 	}
 }
 
 void Editor::Document::insert_line(line_t index, std::string text) {
-	_lines.emplace(_lines.begin() + index, text);
+	_lines.insert(index, Line(std::move(text)));
 	_maxline = _lines.size() - 1;
+	changed(index, 0, 1);
 }
 
 Editor::line_t Editor::Document::append_line(std::string text) {
 	_maxline = _lines.size();
-	_lines.emplace_back(text);
+	_lines.append(Line(std::move(text)));
+	changed(_maxline, 0, 1);
 	return _maxline;
 }
 
-void Editor::Document::append_to_line(line_t index, std::string suffix) {
-	update_line(index, _lines[index] + suffix);
+void Editor::Document::changed(line_t index, line_t removed, line_t added) {
+	for (auto obs: _observers) {
+		obs->lines_changed(index, removed, added);
+	}
 }
 
-void Editor::Document::push_to_line(line_t index, std::string prefix) {
-	update_line(index, prefix + _lines[index]);
+void Editor::Document::index_lines(const char *text, const char *end) {
+	// Small files are quick to index, so we'll just do it all right now. For
+	// a big file, we'll index enough to fill the screen, and leave the rest
+	// to a background thread. Lines go into the rope a block at a time,
+	// since that is cheaper than appending them one by one.
+	const size_t kBlockSize = 1 << 20;
+	const size_t kForegroundLimit = 8 * kBlockSize;
+	const size_t kFirstScreen = 256;
+	size_t bytes = end - text;
+	std::shared_ptr<LineScanner> scanner(new LineScanner(text, end));
+	std::vector<Line> lines;
+	while (!scanner->done()) {
+		scanner->next(kBlockSize, lines);
+		_lines.append(std::move(lines));
+		lines.clear();
+		if (bytes > kForegroundLimit && _lines.size() >= kFirstScreen) break;
+	}
+	if (scanner->done()) return;
+	_indexer.reset(new Indexer);
+	_indexer->cancel.store(false);
+	Indexer *ix = _indexer.get();
+	_indexer->worker = std::thread([ix, scanner]() {
+		while (!scanner->done() && !ix->cancel.load()) {
+			std::vector<Line> batch;
+			scanner->next(4 * kBlockSize, batch);
+			{
+				std::lock_guard<std::mutex> lock(ix->mutex);
+				ix->batches.push_back(std::move(batch));
+				ix->ready.notify_all();
+			}
+			// Wake up the main loop so it can collect the new lines.
+			kill(getpid(), SIGIO);
+		}
+		{
+			std::lock_guard<std::mutex> lock(ix->mutex);
+			ix->done = true;
+			ix->ready.notify_all();
+		}
+		kill(getpid(), SIGIO);
+	});
 }
 
 Editor::location_t Editor::Document::sanitize(const location_t &loc) {
 	// Verify that this location refers to a real place.
 	// Fix it if either of its dimensions would be out-of-bounds.
+	wait_for(loc.line);
 	line_t index = std::min(loc.line, _lines.size()-1);
 	offset_t offset = 0;
 	if (!_lines.empty()) {
@@ -355,6 +474,7 @@ bool Editor::Document::attempt_modify() {
 		_modified = true;
 		_status = "Modified";
 	}
+	if (_modified) ++_generation;
 	return _modified;
 }
 
@@ -18,27 +18,67 @@
 #ifndef EDITOR_DOCUMENT_H
 #define EDITOR_DOCUMENT_H
 
+#include <algorithm>
 #include <string>
 #include <memory>
 #include <vector>
 #include "editor/coordinates.h"
 #include "editor/changelist.h"
+#include "editor/journal.h"
+#include "editor/mapping.h"
+#include "editor/rope.h"
+#include "editor/writer.h"
 
 // A document breaks a text buffer into lines, then maps those lines onto an
 // infinite plane of equally sized character cells.
 namespace Editor {
 class Document {
 public:
-	Document() {}
+	Document();
 	Document(std::string path);
-	void Write(std::string path);
-	std::string status() const { return _status; }
+	~Document();
+	void Write(std::string path, Durability durability = Durability::File);
+	// A snapshot holds the document's text as it was at one moment, so it can
+	// be written out on another thread while editing continues. It shares the
+	// document's rope, so taking one costs nothing until the next edit. Once
+	// it has been saved, the document is unmodified unless it has changed
+	// since.
+	struct Snapshot {
+		Rope lines;
+		std::shared_ptr<Mapping> original;
+		unsigned generation;
+		size_t journal;
+	};
+	std::shared_ptr<Snapshot> snapshot();
+	void saved(const Snapshot &snap);
+	std::string status() const;
 	bool modified() const { return _modified; }
 	bool can_undo() const { return _edits.can_undo(); }
 	bool can_redo() const { return _edits.can_redo(); }
-	location_t undo(Update &update) { return _edits.undo(*this, update); }
-	location_t redo(Update &update) { return _edits.redo(*this, update); }
+	location_t undo() { return _edits.undo(*this); }
+	location_t redo() { return _edits.redo(*this); }
 	void commit() { _edits.commit(); }
+	void set_undo_budget(size_t bytes) { _edits.set_budget(bytes); }
+	size_t undo_depth() const { return _edits.depth(); }
+	size_t undo_memory() const { return _edits.memory(); }
+	// Keep a journal of unsaved edits to the file at this path, so they can
+	// be recovered after a crash; replay the edits found in such a journal;
+	// or throw them away, when the user decides against them.
+	void journal(std::string path);
+	void replay(const std::vector<Journal::edit_t> &edits);
+	void discard_journal();
+
+	// An observer hears about every change to the document's lines, so it
+	// can keep information derived from them up to date.
+	class Observer {
+	public:
+		virtual ~Observer() = default;
+		// Beginning at this index, some lines were removed and some number of
+		// new lines were put in their place.
+		virtual void lines_changed(
+				line_t index, line_t removed, line_t added) = 0;
+	};
+	void add_observer(Observer *obs) { _observers.push_back(obs); }
 
 	// Where are the beginning and end of the document?
 	location_t home();
@@ -50,15 +90,24 @@ public:
 	location_t end(location_t loc) { return end(loc.line); }
 	// Which is the last valid line index in the document?
 	line_t maxline() const { return _maxline; }
+	// Are we still looking for the rest of the lines in a big file? Poll
+	// collects any which have been found, returning true if anything changed;
+	// wait_for blocks until the indexed line exists or indexing is complete.
+	bool indexing() const { return _indexer != nullptr; }
+	bool poll();
+	void wait_for(line_t index);
 
-	// Where is the character which follows or precedes this one?
+	// Where is the character which follows or precedes this one? Characters
+	// are grapheme clusters, not individual codepoints.
 	location_t next_char(location_t loc);
 	location_t prev_char(location_t loc);
-	// Where is the next occurrence of the specified string?
-	Range find(std::string text, location_t begin);
 
 	// Get the raw text of the indexed source line.
-	const std::string &line(line_t index) const;
+	const Line &line(line_t index) const;
+	// Invoke the function for each line in the range, in order.
+	template <typename F> void scan(line_t begin, line_t end, F fn) const {
+		_lines.scan(begin, std::min(end, _lines.size()), fn);
+	}
 	// Get a specific codepoint.
 	char32_t codepoint(location_t) const;
 	// Retrieve the text within the range as a contiguous string.
@@ -79,26 +128,37 @@ private:
 	std::string substr_from_home(const location_t &loc);
 	void update_line(line_t index, std::string text);
 	void insert_line(line_t index, std::string text);
-	void push_to_line(line_t index, std::string prefix);
-	void append_to_line(line_t index, std::string suffix);
 	line_t append_line(std::string text);
+	void index_lines(const char *text, const char *end);
+	void changed(line_t index, line_t removed, line_t added);
 	void sanitize(location_t *loc);
 	location_t sanitize(const location_t &loc);
 	bool attempt_modify();
 	void clear_modify();
 
-	std::string _blank;
-	std::vector<std::string> _lines;
+	Line _blank;
+	Rope _lines;
+	// The bytes we originally read from the file, which unedited lines share.
+	std::shared_ptr<Mapping> _original;
+	// Background line indexing state for a big file, if still in progress.
+	struct Indexer;
+	std::unique_ptr<Indexer> _indexer;
 	line_t _maxline = 0;	// ubound, not size
 
 	// is the user allowed to make changes in this document?
 	bool _read_only = false;
 	// has the document been edited since it was last read?
 	bool _modified = false;
+	// how many times has the document been edited?
+	unsigned _generation = 0;
 	// what is our user-friendly summary of the file state?
 	std::string _status;
 	// record of all the edits made to this document
 	ChangeList _edits;
+	// record of the edits made since the last save, for crash recovery
+	std::unique_ptr<Journal> _journal;
+	// who wants to know when the lines change?
+	std::vector<Observer*> _observers;
 };
 } // namespace Editor
 
@@ -17,7 +17,10 @@
 
 #include <assert.h>
 #include <cctype>
+#include <cstdlib>
 #include <dirent.h>
+#include <limits.h>
+#include <stdexcept>
 #include <sys/stat.h>
 #ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE
@@ -30,17 +33,34 @@
 #include "editor/editor.h"
 #include "ui/colors.h"
 #include "search/dialog.h"
+#include "unicode/unicode.h"
 
 Editor::View::View():
-		_syntax(Syntax::lookup("")) {
+		_syntax(Syntax::lookup("")),
+		_tokens(_doc, _syntax),
+		_columns(_doc, _config),
+		_matches(_doc) {
 	// new blank buffer
+	_doc.add_observer(&_tokens);
+	_doc.add_observer(&_columns);
+	_doc.add_observer(&_matches);
+	_doc.add_observer(this);
 }
 
 Editor::View::View(std::string targetpath):
 		_targetpath(targetpath),
 		_doc(targetpath),
-		_syntax(Syntax::lookup(targetpath)) {
+		_syntax(Syntax::lookup(targetpath)),
+		_tokens(_doc, _syntax),
+		_columns(_doc, _config),
+		_matches(_doc) {
+	_doc.add_observer(&_tokens);
+	_doc.add_observer(&_columns);
+	_doc.add_observer(&_matches);
+	_doc.add_observer(this);
 	_config.load(targetpath);
+	_doc.set_undo_budget(_config.undo_memory());
+	_doc.journal(targetpath);
 }
 
 void Editor::View::activate(UI::Frame &ctx) {
@@ -64,6 +84,7 @@ void Editor::View::paint_into(WINDOW *dest, State state) {
 		_last_state = state;
 		_last_dest = dest;
 	}
+	move_rows(dest);
 	for (unsigned i = 0; i < _height; ++i) {
 		paint_line(dest, i, state);
 	}
@@ -129,6 +150,26 @@ bool Editor::View::process(UI::Frame &ctx, int ch) {
 	return true;
 }
 
+bool Editor::View::paste(UI::Frame &ctx, const std::string &text) {
+	// A paste is one edit, with one undo step, however long it is.
+	replace_selection(text);
+	postprocess(ctx);
+	return true;
+}
+
+bool Editor::View::poll(UI::Frame &ctx) {
+	// If the document is still indexing a big file, pick up any new lines.
+	if (_doc.poll()) {
+		ctx.repaint();
+		set_status(ctx);
+	}
+	// Report the result of a background save once it has finished.
+	if (_saver && _saver->done()) {
+		finish_save(ctx);
+	}
+	return true;
+}
+
 void Editor::View::set_help(UI::HelpBar::Panel &panel) {
 	panel.cut();
 	panel.copy();
@@ -150,7 +191,36 @@ void Editor::View::select(UI::Frame &ctx, Range range) {
 	postprocess(ctx);
 }
 
+void Editor::View::offer_recovery(UI::Frame &ctx) {
+	auto edits = Journal::recover(_targetpath);
+	if (edits.empty()) return;
+	Dialog::Confirmation dialog;
+	dialog.text = "This file has unsaved changes from an earlier session."
+			" Recover them?";
+	dialog.yes = [this, edits](UI::Frame &ctx) {
+		_doc.replay(edits);
+		_update.all();
+		postprocess(ctx);
+		ctx.show_result("Recovered " + std::to_string(edits.size()) + " edits");
+	};
+	dialog.no = [this](UI::Frame &ctx) {
+		_doc.discard_journal();
+	};
+	dialog.show(ctx);
+}
+
+void Editor::View::lines_changed(line_t index, line_t removed, line_t added) {
+	_update.lines_changed(index, removed, added);
+}
+
 void Editor::View::postprocess(UI::Frame &ctx) {
+	// Opening or closing a block comment can change the look of lines far
+	// beyond the one which was edited.
+	line_t restyle_begin, restyle_end;
+	if (_tokens.restyled(restyle_begin, restyle_end)) {
+		location_t first(restyle_begin, 0), last(restyle_end, 0);
+		_update.range(Range(first, last));
+	}
 	reveal_cursor();
 	if (_update.has_dirty()) {
 		ctx.repaint();
@@ -158,87 +228,211 @@ void Editor::View::postprocess(UI::Frame &ctx) {
 	}
 }
 
-void Editor::View::paint_line(WINDOW *dest, row_t v, State state) {
-	size_t index = v + _scroll.v;
-	if (!_update.is_dirty(index)) return;
-	wmove(dest, (int)v, 0);
-	const std::string &text = _doc.line(index);
-	if (text.empty())
-		return;
-
-	std::vector<int> style(text.size());
-	static Regex trailing_space("[[:space:]]+$");
-	Regex::Match m = trailing_space.find(text);
-	if (!m.empty()) {
-		for (size_t i= m.begin; i < m.end; ++i) {
-			style[i] = UI::Colors::error();
+void Editor::View::move_rows(WINDOW *dest) {
+	// Move the rows already on screen to follow the lines inserted or deleted
+	// since the last paint, then to follow any change in scroll position, so
+	// that only the lines which actually changed need to be drawn again. Rows
+	// which open up have to be filled in, and they move along with any later
+	// shifts; so does the row under a result message, if there is one.
+	std::vector<bool> exposed(_height, false);
+	if (overlaid() && _height > 0) {
+		exposed[_height - 1] = true;
+	}
+	line_t top = _painted_top;
+	_painted_top = _scroll.v;
+	for (auto &shift: _update.shifts()) {
+		if (shift.line < top) {
+			// Everything on screen has moved.
+			_update.all();
+			return;
+		}
+		if (shift.line - top >= _height) continue;
+		row_t v = shift.line - top;
+		row_t count = std::min<row_t>(std::abs(shift.count), _height - v);
+		wmove(dest, (int)v, 0);
+		winsdelln(dest, (int)shift.count);
+		if (shift.count > 0) {
+			exposed.insert(exposed.begin() + v, count, true);
+			exposed.resize(_height);
+		} else {
+			exposed.erase(exposed.begin() + v, exposed.begin() + v + count);
+			exposed.resize(_height, true);
 		}
 	}
-	for (auto &token: Syntax::parse(_syntax, text)) {
-		for (size_t i = token.begin; i < token.end; ++i) {
-			style[i] = token.style();
+	if (_scroll.v > top) {
+		row_t count = _scroll.v - top;
+		if (count >= _height) {
+			_update.all();
+			return;
+		}
+		scroll_rows(dest, (int)count);
+		exposed.erase(exposed.begin(), exposed.begin() + count);
+		exposed.resize(_height, true);
+	} else if (_scroll.v < top) {
+		row_t count = top - _scroll.v;
+		if (count >= _height) {
+			_update.all();
+			return;
 		}
+		scroll_rows(dest, -(int)count);
+		exposed.insert(exposed.begin(), count, true);
+		exposed.resize(_height);
+	}
+	for (row_t v = 0; v < _height; ++v) {
+		if (exposed[v]) _update.at(v + _scroll.v);
+	}
+}
+
+namespace {
+// Abbreviate a byte count for the status bar.
+std::string memory_size(size_t bytes) {
+	if (bytes < 1024) return std::to_string(bytes) + "B";
+	if (bytes < 1024 * 1024) return std::to_string(bytes / 1024) + "K";
+	return std::to_string(bytes / (1024 * 1024)) + "M";
+}
+
+// Rewrite a cluster the terminal would not draw in a single cell of its own:
+// control characters get their visible pictures, and a leading combining mark
+// gets a space to sit on. Returns the number of columns curses will give it.
+unsigned printable(wchar_t *glyph, size_t &n) {
+	int theirs = wcwidth(glyph[0]);
+	if (theirs > 0) return theirs;
+	if (glyph[0] < 0x20) {
+		glyph[0] = 0x2400 + glyph[0];
+	} else if (glyph[0] == 0x7F) {
+		glyph[0] = 0x2421;
+	} else if (theirs < 0) {
+		glyph[0] = 0xFFFD;
+	} else if (n < CCHARW_MAX) {
+		for (size_t i = n++; i > 0; --i) glyph[i] = glyph[i - 1];
+		glyph[0] = L' ';
+	} else {
+		glyph[0] = 0xFFFD;
 	}
+	return 1;
+}
+
+void add_cell(std::vector<cchar_t> &cells, const wchar_t *glyph, int style) {
+	cchar_t cell;
+	attr_t attrs = style & ~A_COLOR;
+	setcchar(&cell, glyph, attrs, PAIR_NUMBER(style), nullptr);
+	cells.push_back(cell);
+}
+} // namespace
+
+void Editor::View::paint_line(WINDOW *dest, row_t v, State state) {
+	size_t index = v + _scroll.v;
+	if (!_update.is_dirty(index)) return;
+	const Line &text = _doc.line(index);
 
+	// Only the part of the line inside the viewrect needs any work, so find
+	// the first character at or before the left edge.
 	bool active = state != State::Inactive;
 	unsigned hoff = _scroll.h;
-	column_t h = 0;
 	unsigned width = _width + hoff;
-	size_t style_index = 0;
-	int len;
-	wchar_t ch;
-	char cell[7] = {0};
-	for (location_t i = _doc.home(index); i < _doc.end(index); i = _doc.next_char(i)) {
-		if (h >= width) break;
-		if (active) {
-			wattrset(dest, style[style_index++]);
-		}
+	size_t pos = _columns.offset(index, hoff);
+	column_t h = _columns.column(index, pos);
+	size_t stop = _columns.offset(index, width);
+	stop = Unicode::next_cluster(text.data(), text.size(), stop);
 
-		ch = _doc.codepoint(i);
-		// If it's a normal character, just draw it. If it's a tab, draw a
-	 	// bullet, then add spaces up til the next tab stop.
-	 	if (ch != '\t') {
-			len = wctomb(cell, ch);
-			if (h >= hoff) waddnstr(dest, cell, std::max(len, 0));
-	 		h += std::max(wcwidth(ch), 1);
-	 	} else {
-	 		chtype bullet = ACS_BULLET;
-	 		do {
-	 			if (h >= hoff) waddch(dest, bullet);
-	 			h++;
-	 			bullet = ' ';
-	 		} while (h < width && 0 != h % _config.indent_size());
-	 	}
-	}
-
-	wattrset(dest, UI::Colors::content(active));
-	if (h < width) {
-		wclrtoeol(dest);
-	}
-
-	if (!active) return;
-	if (_selection.empty()) return;
+	// Trailing whitespace is an error, unless it's part of some token.
+	size_t trailing = text.size();
+	while (trailing > 0 && isspace((unsigned char)text[trailing - 1])) {
+		--trailing;
+	}
+	auto &tokens = _tokens.get(index, pos, stop);
+	auto token = tokens.begin();
+
+	// Which columns of this line are selected? Selected cells are drawn in
+	// reverse video instead of their usual style.
 	column_t selbegin = 0;
-	unsigned selcount = 0;
-	line_t begin_line = _selection.begin().line;
-	line_t end_line = _selection.end().line;
-	if (begin_line < index && end_line > index) {
-		selcount = _width;
-	} else if (begin_line < index && end_line == index) {
-		selcount = column(_selection.end());
-	} else if (begin_line == index && end_line > index) {
-		selbegin = column(_selection.begin());
-		selcount = _width - selbegin;
-	} else if (begin_line == index && end_line == index) {
-		selbegin = column(_selection.begin());
-		selcount = column(_selection.end()) - selbegin;
-	}
-	if (selcount > 0) {
-		// DisplayLine should probably be responsible for this, since setting
-		// A_REVERSE also clears A_ALTCHARSET, which leaves our tab bullets
-		// looking a little strange.
-		mvwchgat(dest, v, selbegin, selcount, A_REVERSE, 0, NULL);
+	column_t selend = 0;
+	if (active && !_selection.empty()) {
+		line_t begin_line = _selection.begin().line;
+		line_t end_line = _selection.end().line;
+		if (begin_line < index) {
+			selbegin = 0;
+		} else if (begin_line == index) {
+			selbegin = column(_selection.begin());
+		}
+		if (end_line > index) {
+			selend = width;
+		} else if (end_line == index) {
+			selend = column(_selection.end());
+		}
+		if (begin_line > index || end_line < index) {
+			selend = 0;
+		}
 	}
+
+	// Build the whole row as an array of cells, then hand it to curses in
+	// one call, rather than setting attributes and adding text piecemeal.
+	int normal = UI::Colors::content(active);
+	_cells.clear();
+	wchar_t glyph[CCHARW_MAX + 1];
+	wchar_t blank[] = {L' ', 0};
+	wchar_t bullet[CCHARW_MAX + 1];
+	attr_t bullet_attrs;
+	short bullet_pair;
+	getcchar(WACS_BULLET, bullet, &bullet_attrs, &bullet_pair, nullptr);
+	while (pos < text.size() && h < width) {
+		int style = normal;
+		if (active) {
+			while (token != tokens.end() && token->end <= pos) ++token;
+			if (pos >= trailing) style = UI::Colors::error();
+			if (token != tokens.end() && token->begin <= pos) {
+				style = token->style();
+			}
+		}
+		// If it's a tab, draw a bullet, then add spaces up til the next tab
+		// stop. Otherwise, draw the whole grapheme cluster.
+		if (text[pos] == '\t') {
+			const wchar_t *fill = bullet;
+			int extra = bullet_attrs;
+			do {
+				int cellstyle = (h >= selbegin && h < selend)? A_REVERSE: style;
+				if (h >= hoff) add_cell(_cells, fill, cellstyle | extra);
+				h++;
+				fill = blank;
+				extra = 0;
+			} while (h < width && 0 != h % _config.indent_size());
+			pos++;
+			continue;
+		}
+		unsigned cols;
+		size_t next = Unicode::next_cluster(text.data(), text.size(), pos, &cols);
+		if (h >= selbegin && h < selend) style = A_REVERSE;
+		if (h >= hoff && h + cols <= width) {
+			size_t n = 0;
+			for (size_t i = pos; i < next && n < CCHARW_MAX;) {
+				glyph[n++] = Unicode::decode(text.data(), text.size(), i);
+			}
+			glyph[n] = 0;
+			// The terminal may not agree with us about how wide a cluster
+			// is; pad it out if narrow, and replace it if too wide, so the
+			// disagreement does not spread along the line.
+			unsigned theirs = printable(glyph, n);
+			if (theirs > cols) {
+				glyph[0] = 0xFFFD;
+				glyph[1] = 0;
+				theirs = 1;
+			}
+			add_cell(_cells, glyph, style);
+			for (; theirs < cols; ++theirs) add_cell(_cells, blank, style);
+		} else {
+			// A wide character straddles the edge of the view; blank the
+			// part of it which would be visible.
+			for (column_t i = std::max(h, hoff); i < h + cols && i < width; ++i) {
+				add_cell(_cells, blank, style);
+			}
+		}
+		h += cols;
+		pos = next;
+	}
+	for (h = std::max(h, hoff); h < width; ++h) {
+		add_cell(_cells, blank, (h >= selbegin && h < selend)? A_REVERSE: normal);
+	}
+	mvwadd_wchnstr(dest, (int)v, 0, _cells.data(), (int)_cells.size());
 }
 
 void Editor::View::reveal_cursor() {
@@ -248,9 +442,11 @@ void Editor::View::reveal_cursor() {
 	if (line < _scroll.v || (line - _scroll.v) >= _height) {
 		// Try to center the viewport over the cursor.
 		_scroll.v = (line > _halfheight) ? (line - _halfheight) : 0;
-		// Don't scroll so far we reveal empty space.
+		// Don't scroll so far we reveal empty space. The document may have
+		// grown since we last painted, if it is still being indexed.
+		_maxscroll = std::max((row_t)_doc.maxline(), _height) - _halfheight;
 		_scroll.v = std::min(_scroll.v, _maxscroll);
-		_update.all();
+		_update.at(line);
 	}
 	// Try to keep the view scrolled left if possible, but if that would put the
 	// cursor offscreen, scroll right by the cursor position plus a few extra.
@@ -285,12 +481,26 @@ void Editor::View::update_dimensions(WINDOW *view) {
 	if (newmax != _maxscroll) {
 		_maxscroll = newmax;
 		_scroll.v = std::min(_scroll.v, _maxscroll);
-		_update.all();
 	}
 }
 
 void Editor::View::set_status(UI::Frame &ctx) {
 	std::string status = _doc.status();
+	if (_saver) {
+		if (!status.empty()) status.push_back(' ');
+		status += "Saving...";
+	}
+	if (_doc.can_undo()) {
+		if (!status.empty()) status.push_back(' ');
+		status += "Undo " + std::to_string(_doc.undo_depth());
+		status += " (" + memory_size(_doc.undo_memory()) + ")";
+	}
+	size_t match = _matches.index(_selection);
+	if (match < _matches.size() && _matches.complete()) {
+		if (!status.empty()) status.push_back(' ');
+		status += "Match " + std::to_string(1 + match);
+		status += " of " + std::to_string(_matches.size());
+	}
 	if (!status.empty()) status.push_back(' ');
 	status.push_back('@');
 	// humans use weird 1-based line numbers
@@ -322,6 +532,9 @@ void Editor::View::ctl_paste(UI::Frame &ctx) {
 }
 
 void Editor::View::ctl_close(UI::Frame &ctx) {
+	// If a save is already underway, the document may be about to become
+	// unmodified, so find out how it went before we decide anything.
+	if (_saver) finish_save(ctx);
 	if (!_doc.modified()) {
 		// no formality needed, we're done
 		ctx.app().close_file(_targetpath);
@@ -337,7 +550,8 @@ void Editor::View::ctl_close(UI::Frame &ctx) {
 		}
 	};
 	dialog.no = [this](UI::Frame &ctx) {
-		// just close it
+		// just close it, and forget the edits for good
+		_doc.discard_journal();
 		ctx.app().close_file(_targetpath);
 	};
 	dialog.show(ctx);
@@ -349,7 +563,7 @@ void Editor::View::ctl_save(UI::Frame &ctx) {
 		ctl_save_as(ctx);
 		return;
 	}
-	save(ctx, _targetpath);
+	start_save(ctx, _targetpath);
 }
 
 void Editor::View::ctl_save_as(UI::Frame &ctx) {
@@ -370,6 +584,8 @@ void Editor::View::ctl_save_as(UI::Frame &ctx) {
 			ctx.app().rename_file(_targetpath, path);
 			_targetpath = path;
 			_config.load(_targetpath);
+			_doc.set_undo_budget(_config.undo_memory());
+			_doc.journal(_targetpath);
 			ctx.set_title(path);
 		}
 	};
@@ -383,7 +599,8 @@ void Editor::View::ctl_toline(UI::Frame &ctx) {
 	Dialog::Form dialog;
 	dialog.fields = {
 		{
-			"Go to line (of " + std::to_string(_doc.maxline() + 1) + ")",
+			"Go to line (of " + std::to_string(_doc.maxline() + 1) +
+					(_doc.indexing()? "+)": ")"),
 			std::to_string(_cursor.line + 1)
 		}
 	};
@@ -404,7 +621,7 @@ void Editor::View::ctl_find(UI::Frame &ctx) {
 	find.value = _find_text;
 	Range anchor = _selection;
 	find.updater = [this, anchor, &ctx](std::string pattern) {
-		this->find(ctx, anchor.begin(), pattern);
+		this->preview(ctx, anchor.begin(), pattern);
 	};
 	Dialog::Form dialog;
 	dialog.fields = {find};
@@ -431,7 +648,7 @@ void Editor::View::ctl_replace(UI::Frame &ctx) {
 	find.value = _find_text;
 	Range anchor = _selection;
 	find.updater = [this, anchor, &ctx](std::string pattern) {
-		this->find(ctx, anchor.begin(), pattern);
+		this->preview(ctx, anchor.begin(), pattern);
 	};
 	Dialog::Form::Field repl;
 	repl.name = "Replace";
@@ -458,7 +675,13 @@ void Editor::View::ctl_replace(UI::Frame &ctx) {
 
 void Editor::View::ctl_find_next(UI::Frame &ctx) {
 	if (_find_next_action == FindNextAction::Nothing) return;
-	if (_find_text.empty() || !find(ctx, _selection.end(), _find_text)) {
+	// Matches may overlap, so when a match is selected, the next one may
+	// begin anywhere after the beginning of this one.
+	location_t from = _selection.end();
+	if (_matches.index(_selection) < _matches.size()) {
+		from = _doc.next_char(_selection.begin());
+	}
+	if (_find_text.empty() || !find(ctx, from, _find_text)) {
 		_find_next_action = FindNextAction::Nothing;
 		return;
 	}
@@ -467,11 +690,11 @@ void Editor::View::ctl_find_next(UI::Frame &ctx) {
 }
 
 void Editor::View::ctl_undo(UI::Frame &ctx) {
-	move_cursor(_doc.undo(_update));
+	move_cursor(_doc.undo());
 }
 
 void Editor::View::ctl_redo(UI::Frame &ctx) {
-	move_cursor(_doc.redo(_update));
+	move_cursor(_doc.redo());
 }
 
 void Editor::View::ctl_open_next(UI::Frame &ctx) {
@@ -516,7 +739,6 @@ void Editor::View::ctl_open_next(UI::Frame &ctx) {
 
 void Editor::View::delete_selection() {
 	if (_selection.empty()) return;
-	_update.forward(_selection.begin());
 	move_cursor(_doc.erase(_selection));
 }
 
@@ -524,9 +746,6 @@ Editor::Range Editor::View::replace_selection(std::string clip) {
 	delete_selection();
 	location_t oldloc = _cursor;
 	location_t newloc = _doc.insert(oldloc, clip);
-	if (oldloc.line != newloc.line) {
-		_update.forward(oldloc);
-	}
 	move_cursor(newloc);
 	_doc.commit();
 	return Range(oldloc, newloc);
@@ -603,7 +822,6 @@ void Editor::View::key_enter(UI::Frame &ctx) {
 	// Split the line at the cursor position, but don't move the cursor.
 	delete_selection();
 	_doc.split(_cursor);
-	_update.forward(_cursor);
 }
 
 void Editor::View::key_return(UI::Frame &ctx) {
@@ -612,11 +830,11 @@ void Editor::View::key_return(UI::Frame &ctx) {
 	line_t old_index = _cursor.line;
 	move_cursor(_doc.split(_cursor));
 	// Add whatever string of whitespace characters begins the previous line.
-	for (char ch: _doc.line(old_index)) {
+	Line prev = _doc.line(old_index);
+	for (char ch: prev) {
 		if (!isspace(ch)) break;
 		key_insert(ch);
 	}
-	_update.forward(_cursor);
 }
 
 void Editor::View::key_backspace(UI::Frame &ctx) {
@@ -648,17 +866,7 @@ void Editor::View::extend_selection(location_t loc) {
 
 Editor::column_t Editor::View::column(location_t loc) {
 	// On which screen column does the character at this location appear?
-	column_t col = 0;
-	for (location_t i = _doc.home(loc); i < loc; i = _doc.next_char(i)) {
-		char32_t ch = _doc.codepoint(i);
-		if (ch == '\t') {
-			++col;
-			col += (_config.indent_size() - col % _config.indent_size());
-		} else {
-			col += std::max(wcwidth(ch), 1);
-		}
-	}
-	return col;
+	return _columns.column(loc.line, loc.offset);
 }
 
 Editor::location_t Editor::View::arrow_up() {
@@ -668,9 +876,7 @@ Editor::location_t Editor::View::arrow_up() {
 	column_t h = column(_cursor);
 	location_t dest = _doc.prev_char(_doc.home(_cursor));
 	if (dest.line != _cursor.line) {
-		while (column(dest) > h) {
-			dest = _doc.prev_char(dest);
-		}
+		dest.offset = _columns.offset(dest.line, h);
 	}
 	return dest;
 }
@@ -682,9 +888,7 @@ Editor::location_t Editor::View::arrow_down() {
 	column_t h = column(_cursor);
 	location_t dest = _doc.end(_doc.next_char(_doc.end(_cursor)));
 	if (dest.line != _cursor.line) {
-		while (column(dest) > h) {
-			dest = _doc.prev_char(dest);
-		}
+		dest.offset = _columns.offset(dest.line, h);
 	}
 	return dest;
 }
@@ -723,33 +927,68 @@ Editor::location_t Editor::View::page_down() {
 }
 
 bool Editor::View::save(UI::Frame &ctx, std::string dest) {
+	return start_save(ctx, dest) && finish_save(ctx);
+}
+
+bool Editor::View::start_save(UI::Frame &ctx, std::string dest) {
 	_doc.commit();
-	bool good = false;
+	// Only one save at a time, please; let any earlier save finish first.
+	if (_saver) finish_save(ctx);
 	try {
-		_doc.Write(dest);
-		std::string stat = "Wrote " + std::to_string(_doc.maxline()+1);
-		stat += (_doc.maxline() >= 1) ? " lines" : " line";
-		ctx.show_result(stat);
-		good = true;
+		_saver.reset(new Saver(_doc.snapshot(), dest, _config.durability()));
 	} catch (const std::runtime_error &e) {
 		ctx.show_result(e.what());
+		return false;
+	}
+	set_status(ctx);
+	return true;
+}
+
+bool Editor::View::finish_save(UI::Frame &ctx) {
+	_saver->wait();
+	std::string err = _saver->error();
+	bool good = err.empty();
+	if (good) {
+		_doc.saved(_saver->snapshot());
+		size_t count = _saver->snapshot().lines.size();
+		std::string stat = "Wrote " + std::to_string(count);
+		stat += (count > 1) ? " lines" : " line";
+		ctx.show_result(stat);
+	} else {
+		ctx.show_result(err);
 	}
-	ctx.set_status(_doc.status());
+	_saver.reset();
+	set_status(ctx);
 	return good;
 }
 
 bool Editor::View::find(
 		UI::Frame &ctx, location_t anchor, std::string pattern) {
-	// Look for the pattern after the anchor point.
-	Range match = _doc.find(pattern, anchor);
+	// The match index covers the whole document, so we must wait for the
+	// rest of a big file to arrive. Take the first match after the anchor,
+	// wrapping around to the beginning of the document if necessary.
+	_doc.wait_for(SIZE_MAX);
+	_matches.search(pattern);
+	Range match = _matches.next(anchor);
 	if (match.empty()) {
-		// Look for the pattern after the beginning of the document.
-		match = _doc.find(pattern, _doc.home());
-		if (match.empty()) {
-			// The document does not contain any instances of the pattern.
-			match = Range(anchor, anchor);
-		}
+		// The document does not contain any instances of the pattern.
+		match = Range(anchor, anchor);
 	}
 	select(ctx, match);
+	set_status(ctx);
 	return !match.empty();
 }
+
+void Editor::View::preview(
+		UI::Frame &ctx, location_t anchor, std::string pattern) {
+	// While the user is still typing the pattern, only look for it among the
+	// lines in view, so each keystroke costs a screenful of searching instead
+	// of the whole document. The full index waits until the search is done.
+	_matches.preview(pattern, _scroll.v, _scroll.v + _height);
+	Range match = _matches.next(anchor);
+	if (match.empty()) {
+		match = Range(anchor, anchor);
+	}
+	select(ctx, match);
+	set_status(ctx);
+}
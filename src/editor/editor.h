@@ -18,27 +18,41 @@
 #ifndef EDITOR_EDITOR_H
 #define EDITOR_EDITOR_H
 
+#include <vector>
 #include "app/syntax.h"
+#include "editor/columns.h"
 #include "editor/config.h"
 #include "editor/document.h"
+#include "editor/matches.h"
+#include "editor/saver.h"
+#include "editor/tokencache.h"
 #include "editor/update.h"
 #include "ui/view.h"
 
 namespace Editor {
-class View : public UI::View {
+class View : public UI::View, private Document::Observer {
 public:
 	View();
 	View(std::string targetpath);
 	virtual void activate(UI::Frame &ctx) override;
 	virtual void deactivate(UI::Frame &ctx) override;
 	virtual bool process(UI::Frame &ctx, int ch) override;
+	virtual bool paste(UI::Frame &ctx, const std::string &text) override;
+	virtual bool poll(UI::Frame &ctx) override;
 	virtual void set_help(UI::HelpBar::Panel &panel) override;
 	void select(UI::Frame &ctx, Range range);
+	// If the program died with unsaved edits to this file, offer them back.
+	void offer_recovery(UI::Frame &ctx);
+	// Is a save still being written to disk?
+	bool saving() const { return _saver && !_saver->done(); }
 protected:
 	virtual void paint_into(WINDOW *view, State state) override;
 	virtual void clear_overlay() override;
 private:
+	virtual void lines_changed(
+			line_t index, line_t removed, line_t added) override;
 	void postprocess(UI::Frame &ctx);
+	void move_rows(WINDOW *view);
 	void paint_line(WINDOW *view, row_t v, State state);
 	void reveal_cursor();
 	void update_dimensions(WINDOW *view);
@@ -86,17 +100,26 @@ private:
 	location_t page_up();
 	location_t page_down();
 
+	// Saving happens in the background; save() waits for the result, while
+	// start_save() returns immediately and poll() reports when it's done.
 	bool save(UI::Frame &ctx, std::string dest);
+	bool start_save(UI::Frame &ctx, std::string dest);
+	bool finish_save(UI::Frame &ctx);
 	bool find(UI::Frame &ctx, location_t anchor, std::string pattern);
+	void preview(UI::Frame &ctx, location_t anchor, std::string pattern);
 
 	// Information about the file being edited
 	std::string _targetpath;
 	Document _doc;
 	// Syntax for this document's file type
 	const Syntax::Grammar &_syntax;
+	TokenCache _tokens;
 
 	// Information about the editor window
 	Config _config;
+	ColumnCache _columns;
+	Matches _matches;
+	std::unique_ptr<Saver> _saver;
 	Update _update;
 	location_t _cursor;
 	location_t _anchor;
@@ -117,8 +140,12 @@ private:
 	row_t _height = 0;
 	row_t _halfheight = 0;
 	row_t _maxscroll = 0;
-	// Where is the viewrect origin?
+	// Where is the viewrect origin? Which line was at the top of the view
+	// when it was last painted?
 	position_t _scroll = {0,0};
+	line_t _painted_top = 0;
+	// Scratch space for assembling a row of cells before drawing it.
+	std::vector<cchar_t> _cells;
 };
 } // namespace Editor
 
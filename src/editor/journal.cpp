@@ -0,0 +1,297 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/journal.h"
+#include "app/path.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+std::set<Editor::Journal*> s_journals;
+
+const char kMagic[] = "OZJ1";
+enum: char {
+	kErase = 'e',
+	kInsert = 'i',
+	kSplit = 's',
+};
+
+void put(std::string &out, size_t n) {
+	// Numbers are stored seven bits at a time, low bits first, with the high
+	// bit set on every byte but the last.
+	while (n >= 0x80) {
+		out.push_back(static_cast<char>(0x80 | (n & 0x7F)));
+		n >>= 7;
+	}
+	out.push_back(static_cast<char>(n));
+}
+
+void put(std::string &out, const Editor::location_t &loc) {
+	put(out, loc.line);
+	put(out, loc.offset);
+}
+
+bool get(const std::string &in, size_t &pos, size_t &n) {
+	n = 0;
+	for (unsigned shift = 0; pos < in.size() && shift < 64; shift += 7) {
+		unsigned char byte = in[pos++];
+		n |= static_cast<size_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+bool get(const std::string &in, size_t &pos, Editor::location_t &loc) {
+	return get(in, pos, loc.line) && get(in, pos, loc.offset);
+}
+
+std::string directory() {
+	return Path::home_dir() + "/.ozette/journal";
+}
+
+std::string filename(const std::string &path) {
+	// Name the journal after a hash of the path it belongs to; FNV-1a.
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char ch: path) {
+		hash = (hash ^ ch) * 1099511628211ULL;
+	}
+	char buf[17];
+	snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+	return directory() + "/" + buf;
+}
+
+std::string header(const std::string &path) {
+	// The journal's edits only make sense against the file as it was when
+	// the journal began, so identify that version of the file.
+	std::string out(kMagic);
+	put(out, path.size());
+	out += path;
+	struct stat st;
+	if (0 == stat(path.c_str(), &st)) {
+		put(out, 1);
+		put(out, st.st_size);
+		put(out, st.st_mtim.tv_sec);
+		put(out, st.st_mtim.tv_nsec);
+	} else {
+		put(out, 0);
+	}
+	return out;
+}
+} // namespace
+
+Editor::Journal::Journal(std::string path):
+		_path(Path::absolute(path)),
+		_file(filename(_path)),
+		_header(header(_path)) {
+	s_journals.insert(this);
+}
+
+Editor::Journal::~Journal() {
+	s_journals.erase(this);
+	write();
+	sync();
+	if (_fd >= 0) close(_fd);
+}
+
+void Editor::Journal::erase(const Range &span) {
+	_pending.push_back(kErase);
+	put(_pending, span.begin());
+	put(_pending, span.end());
+}
+
+void Editor::Journal::insert(location_t loc, const std::string &text) {
+	_pending.push_back(kInsert);
+	put(_pending, loc);
+	put(_pending, text.size());
+	_pending += text;
+}
+
+void Editor::Journal::split(location_t loc) {
+	_pending.push_back(kSplit);
+	put(_pending, loc);
+}
+
+void Editor::Journal::rebase(size_t mark) {
+	// The file on disk now holds everything up to the mark, so the journal
+	// starts over from there with whatever has been recorded since. Those
+	// records are either in the old journal file or still pending.
+	// Edits only make sense in sequence, so if the written ones can't be
+	// read back, the pending ones must go too.
+	std::string records;
+	size_t skip = mark > _written ? mark - _written : 0;
+	if ((mark >= _written || read_back(mark, records)) &&
+			skip < _pending.size()) {
+		records.append(_pending, skip, std::string::npos);
+	}
+	_header = header(_path);
+	_pending.clear();
+	_written = 0;
+	_unsynced = false;
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
+	if (records.empty()) {
+		unlink(_file.c_str());
+		return;
+	}
+	// Replace the old journal with the new one all at once, so that there is
+	// always one journal or the other on disk.
+	std::string temp = _file + ".new";
+	int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	std::string data = _header + records;
+	if (fd < 0 ||
+			::write(fd, data.data(), data.size()) != (ssize_t)data.size() ||
+			fdatasync(fd) || rename(temp.c_str(), _file.c_str())) {
+		if (fd >= 0) close(fd);
+		unlink(temp.c_str());
+		// Keep the records; the next write will start a fresh journal.
+		_pending.swap(records);
+		return;
+	}
+	_fd = fd;
+	_written = records.size();
+}
+
+void Editor::Journal::discard() {
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
+	unlink(_file.c_str());
+	_pending.clear();
+	_written = 0;
+	_unsynced = false;
+}
+
+void Editor::Journal::write_all() {
+	for (auto journal: s_journals) {
+		journal->write();
+	}
+}
+
+bool Editor::Journal::unsynced() {
+	for (auto journal: s_journals) {
+		if (journal->_unsynced) return true;
+	}
+	return false;
+}
+
+void Editor::Journal::sync_all() {
+	for (auto journal: s_journals) {
+		journal->sync();
+	}
+}
+
+std::vector<Editor::Journal::edit_t> Editor::Journal::recover(std::string path) {
+	std::vector<edit_t> out;
+	path = Path::absolute(path);
+	std::ifstream file(filename(path), std::ios::binary);
+	if (!file) return out;
+	std::string data((std::istreambuf_iterator<char>(file)),
+			std::istreambuf_iterator<char>());
+	std::string head = header(path);
+	if (0 != data.compare(0, head.size(), head)) return out;
+	// Read as many complete records as there are; the last may have been
+	// cut short when the program died.
+	size_t pos = head.size();
+	while (pos < data.size()) {
+		edit_t edit;
+		char op = data[pos++];
+		location_t begin, end;
+		size_t len = 0;
+		if (op == kErase && get(data, pos, begin) && get(data, pos, end)) {
+			edit.op = edit_t::Erase;
+			edit.span = Range(begin, end);
+		} else if (op == kInsert && get(data, pos, begin) &&
+				get(data, pos, len) && len <= data.size() - pos) {
+			edit.op = edit_t::Insert;
+			edit.span = Range(begin, begin);
+			edit.text = data.substr(pos, len);
+			pos += len;
+		} else if (op == kSplit && get(data, pos, begin)) {
+			edit.op = edit_t::Split;
+			edit.span = Range(begin, begin);
+		} else {
+			break;
+		}
+		out.push_back(edit);
+	}
+	return out;
+}
+
+void Editor::Journal::write() {
+	// Append the records made since the last write. The file is created
+	// when there is first something to put in it.
+	if (_pending.empty()) return;
+	if (_fd < 0) {
+		mkdir((Path::home_dir() + "/.ozette").c_str(), S_IRWXU);
+		mkdir(directory().c_str(), S_IRWXU);
+		int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		_fd = open(_file.c_str(), flags, 0600);
+		if (_fd < 0) return;
+		if (::write(_fd, _header.data(), _header.size()) < 0) {
+			close(_fd);
+			_fd = -1;
+			return;
+		}
+		_written = 0;
+	}
+	size_t done = 0;
+	while (done < _pending.size()) {
+		ssize_t count = ::write(_fd, _pending.data() + done, _pending.size() - done);
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		done += count;
+	}
+	_pending.erase(0, done);
+	_written += done;
+	_unsynced = true;
+}
+
+bool Editor::Journal::read_back(size_t mark, std::string &out) {
+	// Read the records written to the journal file after the mark.
+	int fd = open(_file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+	out.resize(_written - mark);
+	off_t pos = _header.size() + mark;
+	size_t done = 0;
+	while (done < out.size()) {
+		ssize_t count = pread(fd, &out[done], out.size() - done, pos + done);
+		if (count < 0 && errno == EINTR) continue;
+		if (count <= 0) break;
+		done += count;
+	}
+	close(fd);
+	if (done == out.size()) return true;
+	out.clear();
+	return false;
+}
+
+void Editor::Journal::sync() {
+	if (!_unsynced || _fd < 0) return;
+	fdatasync(_fd);
+	_unsynced = false;
+}
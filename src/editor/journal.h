@@ -0,0 +1,78 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_JOURNAL_H
+#define EDITOR_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include "editor/coordinates.h"
+
+// A journal records the edits made to a document since it was last saved,
+// so they can be recovered if the program dies before the user saves them.
+// Records go into a file under ~/.ozette/journal: they are written in groups,
+// once the main loop has finished handling a batch of events, and synced to
+// disk once the user has paused. Only records not yet written are kept in
+// memory. Replaying a journal takes time in proportion to the edits it holds,
+// not to the size of the file.
+namespace Editor {
+class Journal {
+public:
+	// Begin recording edits to the file at this path, as it is on disk now.
+	Journal(std::string path);
+	// Write out whatever is pending, but leave the file for recovery.
+	~Journal();
+	void erase(const Range &span);
+	void insert(location_t loc, const std::string &text);
+	void split(location_t loc);
+	// How much has been recorded so far? When a snapshot of the document has
+	// been saved, the edits recorded up to that point are no longer needed,
+	// and the journal starts over from the file's new contents.
+	size_t mark() const { return _written + _pending.size(); }
+	void rebase(size_t mark);
+	// The user has decided against the edits; delete the journal.
+	void discard();
+
+	// Write the pending records for every journal, and sync them to disk.
+	static void write_all();
+	static bool unsynced();
+	static void sync_all();
+
+	// An edit recovered from a journal.
+	struct edit_t {
+		enum { Erase, Insert, Split } op;
+		Range span;
+		std::string text;
+	};
+	// Read the edits from a journal left behind for this file, if there is one
+	// and the file has not changed since.
+	static std::vector<edit_t> recover(std::string path);
+private:
+	void write();
+	bool read_back(size_t mark, std::string &out);
+	void sync();
+	std::string _path;
+	std::string _file;
+	std::string _header;
+	std::string _pending;
+	size_t _written = 0;
+	int _fd = -1;
+	bool _unsynced = false;
+};
+} // namespace Editor
+
+#endif //EDITOR_JOURNAL_H
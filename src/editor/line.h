@@ -0,0 +1,68 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_LINE_H
+#define EDITOR_LINE_H
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace Editor {
+// A line is a run of text without its terminating linebreak. Lines which were
+// read from a file refer directly to the file's bytes, which are shared and
+// never modified; a line which has been edited owns a private copy of its
+// text instead. Either way, a line's text never changes once it has been
+// created, so copies of a line are cheap and remain valid indefinitely.
+class Line {
+public:
+	Line() {}
+	Line(const char *data, size_t size): _data(data), _size(size) {}
+	explicit Line(std::string text):
+			_text(std::make_shared<const std::string>(std::move(text))),
+			_data(_text->data()),
+			_size(_text->size()) {}
+	const char *data() const { return _data; }
+	size_t size() const { return _size; }
+	bool empty() const { return 0 == _size; }
+	char operator[](size_t index) const { return _data[index]; }
+	const char *begin() const { return _data; }
+	const char *end() const { return _data + _size; }
+	// Has this line been edited, or does it still refer to the original file?
+	bool edited() const { return _text.get() != nullptr; }
+	// Copy some or all of the line's text out into a string.
+	std::string str() const { return std::string(_data, _size); }
+	std::string substr(size_t pos, size_t len = std::string::npos) const {
+		pos = std::min(pos, _size);
+		return std::string(_data + pos, std::min(len, _size - pos));
+	}
+	// Where is the next occurrence of the needle at or after this offset?
+	size_t find(const std::string &needle, size_t pos = 0) const {
+		if (pos > _size) return std::string::npos;
+		auto found = std::search(
+				begin() + pos, end(), needle.begin(), needle.end());
+		if (found == end() && !needle.empty()) return std::string::npos;
+		return found - begin();
+	}
+private:
+	std::shared_ptr<const std::string> _text;
+	const char *_data = "";
+	size_t _size = 0;
+};
+} // namespace Editor
+
+#endif // EDITOR_LINE_H
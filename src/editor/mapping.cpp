@@ -0,0 +1,193 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/mapping.h"
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Files smaller than this are simply read into the heap: it costs little, and
+// a copy of our own can't change underneath us.
+const size_t kMapThreshold = 8 << 20;
+
+// The SIGBUS handler must be able to tell whether a faulting address lies in
+// one of our mappings, so every live mapping claims a slot in this table. A
+// signal handler can't take a lock, so the slots are claimed and read with
+// atomic operations instead.
+const size_t kMaxRegions = 64;
+struct Region {
+	std::atomic<char*> begin;
+	std::atomic<size_t> size;
+	std::atomic<bool> truncated;
+};
+Region regions[kMaxRegions];
+size_t page_size;
+struct sigaction previous;
+
+void on_sigbus(int signo, siginfo_t *info, void *context) {
+	char *addr = static_cast<char*>(info->si_addr);
+	for (Region &r: regions) {
+		char *begin = r.begin.load();
+		size_t size = r.size.load();
+		if (!begin || addr < begin || addr >= begin + size) continue;
+		// The file has been truncated. Put zero-filled memory in place of
+		// everything from the faulting page to the end of the mapping, so the
+		// read which faulted, and every later one, finds zeros instead.
+		char *page = begin + ((addr - begin) & ~(page_size - 1));
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+		void *patch = mmap(page, begin + size - page, PROT_READ, flags, -1, 0);
+		if (patch == MAP_FAILED) break;
+		r.truncated.store(true);
+		return;
+	}
+	// This fault is not one we can repair, so put back whatever action was
+	// in place before, and let the faulting instruction run into it again.
+	sigaction(SIGBUS, &previous, nullptr);
+}
+
+int claim_region(char *begin, size_t size) {
+	static std::once_flag installed;
+	std::call_once(installed, []() {
+		page_size = sysconf(_SC_PAGESIZE);
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = on_sigbus;
+		sa.sa_flags = SA_SIGINFO;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGBUS, &sa, &previous);
+	});
+	for (size_t i = 0; i < kMaxRegions; ++i) {
+		char *expected = nullptr;
+		if (!regions[i].begin.compare_exchange_strong(expected, begin)) continue;
+		regions[i].size.store(size);
+		regions[i].truncated.store(false);
+		return i;
+	}
+	return -1;
+}
+
+// Give up a slot in the region table, returning its truncation state.
+bool release_region(int index) {
+	bool truncated = regions[index].truncated.load();
+	regions[index].begin.store(nullptr);
+	return truncated;
+}
+} // namespace
+
+Editor::Mapping::Mapping(const std::string &path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	struct stat st;
+	if (0 == fstat(fd, &st)) {
+		_dev = st.st_dev;
+		_ino = st.st_ino;
+		size_t size = st.st_size;
+		if (S_ISREG(st.st_mode) && size >= kMapThreshold) {
+			void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			// If the region table is full, we could not survive another
+			// program truncating this file, so we'll read it instead.
+			if (addr != MAP_FAILED) {
+				_region = claim_region(static_cast<char*>(addr), size);
+				if (_region < 0) munmap(addr, size);
+			}
+			if (_region >= 0) {
+				_data = static_cast<const char*>(addr);
+				_size = size;
+				_mapped = true;
+			}
+		}
+	}
+	if (!_mapped) {
+		// Small files aren't worth mapping, some files can't be mapped, and
+		// some files claim to be empty even though they are not; read
+		// whatever we can get into the heap.
+		char buf[65536];
+		ssize_t actual = 0;
+		while ((actual = read(fd, buf, sizeof(buf))) > 0) {
+			_heap.append(buf, actual);
+		}
+		_data = _heap.data();
+		_size = _heap.size();
+	}
+	close(fd);
+}
+
+Editor::Mapping::~Mapping() {
+	if (_region >= 0) release_region(_region);
+	if (_mapped) {
+		munmap(const_cast<char*>(_data), _size);
+	}
+}
+
+bool Editor::Mapping::is(const struct stat &st) const {
+	return _ino != 0 && st.st_dev == _dev && st.st_ino == _ino;
+}
+
+bool Editor::Mapping::detach() {
+	if (_region < 0) return true;
+	// Copy the file's bytes aside, then replace the file mapping with
+	// anonymous memory at the same address and copy the bytes back in.
+	std::string copy(_data, _size);
+	void *addr = const_cast<char*>(_data);
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+	if (MAP_FAILED == mmap(addr, _size, prot, flags, -1, 0)) return false;
+	memcpy(addr, copy.data(), _size);
+	mprotect(addr, _size, PROT_READ);
+	// Our bytes no longer depend on the file, so it can't hurt us now.
+	_truncated = release_region(_region);
+	_region = -1;
+	_dev = 0;
+	_ino = 0;
+	return true;
+}
+
+bool Editor::Mapping::intact() const {
+	if (_region < 0) return !_truncated;
+	return !regions[_region].truncated.load();
+}
+
+void Editor::Mapping::find_linebreaks(
+		const char *p, const char *end, std::vector<const char*> &out) {
+#ifdef __SSE2__
+	// Compare sixteen bytes at a time against LF, then walk the bits of the
+	// resulting mask to find the positions of any matches.
+	const __m128i lf = _mm_set1_epi8('\x0A');
+	while (end - p >= 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, lf));
+		while (mask) {
+			out.push_back(p + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+		p += 16;
+	}
+#endif
+	while (p < end) {
+		p = static_cast<const char*>(memchr(p, '\x0A', end - p));
+		if (!p) break;
+		out.push_back(p++);
+	}
+}
@@ -0,0 +1,73 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_MAPPING_H
+#define EDITOR_MAPPING_H
+
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace Editor {
+// A mapping makes the contents of a file available as one contiguous block of
+// read-only memory. Big regular files are mapped directly, so their pages are
+// shared with the OS file cache and only loaded when somebody actually looks
+// at them; small files, and files which can't be mapped, are read into the
+// heap instead.
+//
+// A mapped file is not a private copy. If another program rewrites the file
+// in place, the text we show changes with it; if the file is truncated, the
+// pages past its new end no longer exist, and touching one raises SIGBUS.
+// We catch that signal, replace the missing pages with zeros, and note that
+// the mapping is no longer intact, so the damage can be reported instead of
+// taking down the editor along with the user's unsaved work.
+class Mapping {
+public:
+	explicit Mapping(const std::string &path);
+	Mapping(const Mapping&) = delete;
+	Mapping &operator=(const Mapping&) = delete;
+	~Mapping();
+	const char *data() const { return _data; }
+	const char *end() const { return _data + _size; }
+	size_t size() const { return _size; }
+	// Is this the file we mapped?
+	bool is(const struct stat &st) const;
+	// Someone is about to overwrite the file we mapped. Copy its contents
+	// into private memory at the same address, so that anything which refers
+	// to our bytes will continue to see the original text. Returns false if
+	// the copy could not be made, in which case the file must not be touched.
+	bool detach();
+	// Have we lost any of the file's bytes because it was truncated?
+	bool intact() const;
+	// Find the linebreaks in this block of text, appending the address of each
+	// one to the list. Uses SSE2 where available, examining 16 bytes at a time.
+	static void find_linebreaks(
+			const char *begin, const char *end, std::vector<const char*> &out);
+private:
+	const char *_data = "";
+	size_t _size = 0;
+	bool _mapped = false;
+	// Our slot in the table the SIGBUS handler consults, if mapped.
+	int _region = -1;
+	bool _truncated = false;
+	std::string _heap;
+	dev_t _dev = 0;
+	ino_t _ino = 0;
+};
+} // namespace Editor
+
+#endif // EDITOR_MAPPING_H
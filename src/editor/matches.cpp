@@ -0,0 +1,239 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/matches.h"
+#include <algorithm>
+#include <string.h>
+#include <thread>
+#include "search/substring.h"
+
+namespace {
+// A big document is split into slices of at least this many lines, which
+// are scanned on separate threads.
+const size_t kSlice = 16 * 1024;
+} // namespace
+
+Editor::Matches::Matches(const Document &doc):
+		_doc(doc) {
+}
+
+void Editor::Matches::search(const std::string &needle) {
+	if (needle == _needle && _complete) return;
+	reset(needle);
+	_complete = true;
+	if (_needle.empty()) return;
+	scan(0, _doc.maxline() + 1, _hits);
+}
+
+void Editor::Matches::preview(
+		const std::string &needle, line_t begin, line_t end) {
+	reset(needle);
+	_complete = _needle.empty();
+	if (_needle.empty()) return;
+	scan(begin, std::min(end, _doc.maxline() + 1), _hits);
+}
+
+Editor::Range Editor::Matches::next(location_t loc) const {
+	if (_hits.empty()) return Range();
+	size_t index = lower_bound(loc);
+	return hit(index < _hits.size()? index: 0);
+}
+
+Editor::Range Editor::Matches::prev(location_t loc) const {
+	if (_hits.empty()) return Range();
+	size_t index = lower_bound(loc);
+	return hit(index > 0? index - 1: _hits.size() - 1);
+}
+
+size_t Editor::Matches::index(const Range &range) const {
+	size_t index = lower_bound(range.begin());
+	if (index == _hits.size()) return size();
+	Range found = hit(index);
+	if (found.begin() != range.begin() || found.end() != range.end()) {
+		return size();
+	}
+	return index;
+}
+
+void Editor::Matches::lines_changed(
+		line_t index, line_t removed, line_t added) {
+	if (_needle.empty()) return;
+	// Any match beginning on one of the removed lines is gone, and so is any
+	// match beginning on a line close enough before them that it reached
+	// into them; the new lines must be scanned from the same point.
+	line_t span = _parts.size() - 1;
+	line_t low = index > span? index - span: 0;
+	size_t first = lower_bound(location_t(low, 0));
+	size_t last = lower_bound(location_t(index + removed, 0));
+	// Matches after the change are still good, but they have moved. Bring
+	// the pending shift over to this edit's position, so that one shift can
+	// cover everything after it.
+	if (_pending < first) {
+		shift(_pending, first, _delta);
+	} else if (_pending > last) {
+		shift(last, _pending, -_delta);
+	}
+	_delta += added - removed;
+	std::vector<Hit> found;
+	scan(low, index + added, found);
+	// Put the new matches in place of the old ones; the matches after them
+	// only need to move if the number has changed.
+	size_t common = std::min(last - first, found.size());
+	std::copy(found.begin(), found.begin() + common, _hits.begin() + first);
+	auto rest = _hits.begin() + first + common;
+	if (common < found.size()) {
+		_hits.insert(rest, found.begin() + common, found.end());
+	} else {
+		_hits.erase(rest, _hits.begin() + last);
+	}
+	_pending = first + found.size();
+}
+
+void Editor::Matches::reset(const std::string &needle) {
+	_needle = needle;
+	_parts.clear();
+	_hits.clear();
+	_pending = 0;
+	_delta = 0;
+	if (_needle.empty()) return;
+	size_t pos = 0, brk = 0;
+	while ((brk = _needle.find('\n', pos)) != std::string::npos) {
+		_parts.push_back(_needle.substr(pos, brk - pos));
+		pos = brk + 1;
+	}
+	_parts.push_back(_needle.substr(pos));
+}
+
+Editor::Range Editor::Matches::hit(size_t index) const {
+	Hit h = _hits[index];
+	if (index >= _pending) {
+		h.begin.line += _delta;
+		h.end.line += _delta;
+	}
+	return Range(h.begin, h.end);
+}
+
+size_t Editor::Matches::lower_bound(location_t loc) const {
+	// Find the first match beginning at or after the location.
+	size_t low = 0, high = _hits.size();
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (hit(mid).begin() < loc) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+void Editor::Matches::shift(size_t begin, size_t end, line_t delta) {
+	// Line numbers wrap around, so a negative delta works out as well.
+	for (size_t i = begin; i < end; ++i) {
+		_hits[i].begin.line += delta;
+		_hits[i].end.line += delta;
+	}
+}
+
+void Editor::Matches::scan(
+		line_t begin, line_t end, std::vector<Hit> &out) const {
+	// Small jobs, like rescanning a few edited lines, are not worth the cost
+	// of starting threads. A big document is divided evenly among as many
+	// threads as there are cores; each slice collects its own matches, which
+	// we then join together in order.
+	size_t lines = end > begin? end - begin: 0;
+	size_t threads = std::thread::hardware_concurrency();
+	threads = std::min(threads, lines / kSlice);
+	if (threads < 2) {
+		scan_slice(begin, end, out);
+		return;
+	}
+	std::vector<std::vector<Hit>> found(threads);
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threads; ++i) {
+		line_t slice_begin = begin + lines * i / threads;
+		line_t slice_end = begin + lines * (i + 1) / threads;
+		std::vector<Hit> &slice_out = found[i];
+		workers.emplace_back([this, slice_begin, slice_end, &slice_out]() {
+			scan_slice(slice_begin, slice_end, slice_out);
+		});
+	}
+	for (auto &worker: workers) {
+		worker.join();
+	}
+	for (auto &slice: found) {
+		out.insert(out.end(), slice.begin(), slice.end());
+	}
+}
+
+void Editor::Matches::scan_slice(
+		line_t begin, line_t end, std::vector<Hit> &out) const {
+	line_t index = begin;
+	if (_parts.size() == 1) {
+		// The needle fits on one line, so we can look for it within each line
+		// using the vectorized substring search.
+		size_t len = _needle.size();
+		_doc.scan(begin, end, [&](const Line &text) {
+			const char *pos = text.begin();
+			while ((pos = Search::substring(pos, text.end(), _needle))) {
+				offset_t offset = pos - text.begin();
+				Hit found = {
+					location_t(index, offset),
+					location_t(index, offset + len)
+				};
+				out.push_back(found);
+				++pos;
+			}
+			++index;
+		});
+		return;
+	}
+	// A needle which spans lines can only begin in one place on each line:
+	// its first part must end the line, its middle parts must be whole lines,
+	// and its last part must begin the line after those. Looking up lines by
+	// index is slow, so we keep a window of the lines most recently scanned,
+	// and check each line as the possible end of a match which began on the
+	// earliest line in the window. That means reading past the end of the
+	// slice, to finish any match which begins within it.
+	const std::string &head = _parts.front();
+	const std::string &tail = _parts.back();
+	line_t span = _parts.size() - 1;
+	std::vector<const Line*> window(span + 1);
+	line_t stop = std::min(end + span, _doc.maxline() + 1);
+	_doc.scan(begin, stop, [&](const Line &text) {
+		window[index % window.size()] = &text;
+		if (index++ < begin + span) return;
+		if (text.size() < tail.size()) return;
+		if (memcmp(text.data(), tail.data(), tail.size())) return;
+		line_t start = index - 1 - span;
+		for (line_t i = 1; i < span; ++i) {
+			const Line &mid = *window[(start + i) % window.size()];
+			const std::string &part = _parts[i];
+			if (mid.size() != part.size()) return;
+			if (memcmp(mid.data(), part.data(), part.size())) return;
+		}
+		const Line &first = *window[start % window.size()];
+		if (first.size() < head.size()) return;
+		offset_t offset = first.size() - head.size();
+		if (memcmp(first.data() + offset, head.data(), head.size())) return;
+		Hit found = {
+			location_t(start, offset),
+			location_t(start + span, tail.size())
+		};
+		out.push_back(found);
+	});
+}
@@ -0,0 +1,81 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_MATCHES_H
+#define EDITOR_MATCHES_H
+
+#include <string>
+#include <vector>
+#include "editor/document.h"
+
+namespace Editor {
+// The match index lists every occurrence of the text the user is looking
+// for, in document order, so that finding the next one is a binary search
+// instead of a scan, and we can tell which of how many matches is selected.
+// A needle containing linebreaks matches across lines. The index watches the
+// document and rescans only the lines an edit touches.
+class Matches : public Document::Observer {
+public:
+	Matches(const Document &doc);
+	// Index the occurrences of a new needle; an empty needle clears the index.
+	void search(const std::string &needle);
+	// Index only the occurrences within these lines, as a quick preview while
+	// the user is still typing the needle; search() finishes the job.
+	void preview(const std::string &needle, line_t begin, line_t end);
+	// Does the index cover the whole document?
+	bool complete() const { return _complete; }
+	size_t size() const { return _hits.size(); }
+	// Which is the first match beginning at or after this location? After the
+	// last match we wrap around to the first. If there are no matches at all,
+	// the result is empty.
+	Range next(location_t loc) const;
+	// Which is the last match beginning before this location? Before the
+	// first match we wrap around to the last.
+	Range prev(location_t loc) const;
+	// Which match is this range, counting from zero? Returns size() if the
+	// range is not one of the matches.
+	size_t index(const Range &range) const;
+	virtual void lines_changed(
+			line_t index, line_t removed, line_t added) override;
+private:
+	struct Hit {
+		location_t begin;
+		location_t end;
+	};
+	void reset(const std::string &needle);
+	Range hit(size_t index) const;
+	size_t lower_bound(location_t loc) const;
+	void shift(size_t begin, size_t end, line_t delta);
+	void scan(line_t begin, line_t end, std::vector<Hit> &out) const;
+	void scan_slice(line_t begin, line_t end, std::vector<Hit> &out) const;
+	const Document &_doc;
+	std::string _needle;
+	// The needle broken at its linebreaks, one part per line it spans.
+	std::vector<std::string> _parts;
+	// Ordered by location; matches may overlap.
+	std::vector<Hit> _hits;
+	bool _complete = true;
+	// An edit which adds or removes lines moves every match after it. Rather
+	// than renumber them all each time, we remember that the hits from this
+	// index on are off by some number of lines. The next edit only has to
+	// fix up the hits between its own position and this one.
+	size_t _pending = 0;
+	line_t _delta = 0;
+};
+} // namespace Editor
+
+#endif // EDITOR_MATCHES_H
@@ -0,0 +1,212 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/rope.h"
+#include <assert.h>
+
+const Editor::Line &Editor::Rope::operator[](size_t index) const {
+	assert(index < size());
+	const Node *n = _root.get();
+	for (;;) {
+		size_t lc = count(n->left);
+		size_t own = n->lines.size();
+		if (index < lc) {
+			n = n->left.get();
+		} else if (index < lc + own) {
+			return n->lines[index - lc];
+		} else {
+			index -= lc + own;
+			n = n->right.get();
+		}
+	}
+}
+
+void Editor::Rope::set(size_t index, Line line) {
+	assert(index < size());
+	Node *n = unshare(_root);
+	for (;;) {
+		size_t lc = count(n->left);
+		size_t own = n->lines.size();
+		if (index < lc) {
+			n = unshare(n->left);
+		} else if (index < lc + own) {
+			n->lines[index - lc] = std::move(line);
+			return;
+		} else {
+			index -= lc + own;
+			n = unshare(n->right);
+		}
+	}
+}
+
+void Editor::Rope::insert(size_t index, Line line) {
+	assert(index <= size());
+	if (!_root) {
+		std::vector<Line> lines(1, std::move(line));
+		_root = make_node(std::move(lines));
+		return;
+	}
+	// Walk down to the chunk which contains the insertion point, counting
+	// the new line in every subtree along the way, then insert it in place.
+	// We keep track of the chunk's position so we can split it later.
+	size_t base = 0;
+	Node *n = unshare(_root);
+	for (;;) {
+		n->count++;
+		size_t lc = count(n->left);
+		size_t own = n->lines.size();
+		if (index < lc) {
+			n = unshare(n->left);
+		} else if (index <= lc + own || !n->right) {
+			n->lines.insert(n->lines.begin() + (index - lc), std::move(line));
+			base += lc;
+			break;
+		} else {
+			index -= lc + own;
+			base += lc + own;
+			n = unshare(n->right);
+		}
+	}
+	// If the chunk has grown too large, cut it in half. Splitting the tree
+	// at a position inside the chunk breaks the chunk into two nodes, which
+	// we then merge right back together.
+	if (n->lines.size() > 2 * kChunk) {
+		Tree l, r;
+		split(std::move(_root), base + n->lines.size() / 2, l, r);
+		_root = merge(std::move(l), std::move(r));
+	}
+}
+
+void Editor::Rope::insert(size_t index, std::vector<Line> &&lines) {
+	assert(index <= size());
+	if (lines.empty()) return;
+	if (lines.size() == 1) {
+		insert(index, std::move(lines.front()));
+		return;
+	}
+	Tree l, r;
+	split(std::move(_root), index, l, r);
+	Tree mid = build(std::move(lines));
+	_root = merge(merge(std::move(l), std::move(mid)), std::move(r));
+}
+
+void Editor::Rope::append(std::vector<Line> &&lines) {
+	if (lines.empty()) return;
+	_root = merge(std::move(_root), build(std::move(lines)));
+}
+
+void Editor::Rope::erase(size_t begin, size_t end) {
+	assert(begin <= end && end <= size());
+	if (begin == end) return;
+	Tree l, mid, r;
+	split(std::move(_root), end, mid, r);
+	split(std::move(mid), begin, l, mid);
+	_root = merge(std::move(l), std::move(r));
+}
+
+Editor::Rope::Node *Editor::Rope::unshare(Tree &t) {
+	// Someone else can still see this node, so leave it alone and change a
+	// copy instead. The copy shares the node's children, which will in turn
+	// be copied if they need to change.
+	if (t.use_count() > 1) t = std::make_shared<Node>(*t);
+	return t.get();
+}
+
+void Editor::Rope::update(Node *n) {
+	n->count = count(n->left) + n->lines.size() + count(n->right);
+}
+
+Editor::Rope::Tree Editor::Rope::merge(Tree a, Tree b) {
+	// Join two trees, all of whose lines in a precede all of those in b.
+	if (!a) return b;
+	if (!b) return a;
+	if (a->priority > b->priority) {
+		unshare(a);
+		a->right = merge(std::move(a->right), std::move(b));
+		update(a.get());
+		return a;
+	} else {
+		unshare(b);
+		b->left = merge(std::move(a), std::move(b->left));
+		update(b.get());
+		return b;
+	}
+}
+
+void Editor::Rope::split(Tree t, size_t index, Tree &l, Tree &r) {
+	// Divide this tree into one containing the first index lines and another
+	// containing everything else. If the dividing point falls in the middle
+	// of some node's chunk, the tail of that chunk becomes a new node.
+	if (!t) {
+		l.reset();
+		r.reset();
+		return;
+	}
+	unshare(t);
+	size_t lc = count(t->left);
+	size_t own = t->lines.size();
+	if (index <= lc) {
+		Tree ll;
+		split(std::move(t->left), index, ll, t->left);
+		update(t.get());
+		r = std::move(t);
+		l = std::move(ll);
+	} else if (index >= lc + own) {
+		Tree rr;
+		split(std::move(t->right), index - lc - own, t->right, rr);
+		update(t.get());
+		l = std::move(t);
+		r = std::move(rr);
+	} else {
+		auto cut = t->lines.begin() + (index - lc);
+		std::vector<Line> tail(
+				std::make_move_iterator(cut),
+				std::make_move_iterator(t->lines.end()));
+		t->lines.erase(cut, t->lines.end());
+		Tree right = std::move(t->right);
+		update(t.get());
+		l = std::move(t);
+		r = merge(make_node(std::move(tail)), std::move(right));
+	}
+}
+
+Editor::Rope::Tree Editor::Rope::build(std::vector<Line> &&lines) {
+	// Pack a run of lines into a tree of chunk-sized nodes.
+	Tree out;
+	for (size_t i = 0; i < lines.size(); i += kChunk) {
+		auto first = lines.begin() + i;
+		auto last = lines.begin() + std::min(i + kChunk, lines.size());
+		std::vector<Line> chunk(
+				std::make_move_iterator(first),
+				std::make_move_iterator(last));
+		out = merge(std::move(out), make_node(std::move(chunk)));
+	}
+	lines.clear();
+	return out;
+}
+
+Editor::Rope::Tree Editor::Rope::make_node(std::vector<Line> &&lines) {
+	// xorshift is plenty random enough to keep the treap balanced.
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	Tree n = std::make_shared<Node>();
+	n->lines = std::move(lines);
+	n->priority = _seed;
+	update(n.get());
+	return n;
+}
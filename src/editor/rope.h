@@ -0,0 +1,98 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_ROPE_H
+#define EDITOR_ROPE_H
+
+#include <memory>
+#include <vector>
+#include "editor/line.h"
+
+namespace Editor {
+// A rope stores a sequence of lines as a balanced tree of chunks. Each node
+// owns a short run of consecutive lines and knows how many lines live in its
+// subtree, so we can find, insert, or remove lines anywhere in the sequence
+// in logarithmic time instead of shifting everything which follows them.
+// The tree is a treap: nodes are ordered by position and heap-ordered by a
+// random priority, which keeps it balanced without any explicit rotations.
+// Copying a rope is cheap, since the copy shares its nodes with the original.
+// Nodes are copied on write: before changing a node which some other rope
+// can still see, we replace it with a private copy, so an edit to one rope
+// only copies the handful of nodes on the path it touches. The other rope
+// may be read on another thread while this goes on.
+class Rope {
+public:
+	// Bulk loads pack this many lines into each chunk; a chunk which grows
+	// past twice this size through insertions will be split in half.
+	static const size_t kChunk = 512;
+	size_t size() const { return count(_root); }
+	bool empty() const { return !_root; }
+	const Line &operator[](size_t index) const;
+	// Replace the line at this index with some other line.
+	void set(size_t index, Line line);
+	// Insert one or more lines before the line at this index.
+	void insert(size_t index, Line line);
+	void insert(size_t index, std::vector<Line> &&lines);
+	// Add lines to the end of the sequence.
+	void append(Line line) { insert(size(), std::move(line)); }
+	void append(std::vector<Line> &&lines);
+	// Remove the lines from begin up to but not including end.
+	void erase(size_t begin, size_t end);
+	void clear() { _root.reset(); }
+	// Invoke the function for each line in the range, in order.
+	template <typename F> void scan(size_t begin, size_t end, F fn) const {
+		scan(_root, begin, end, fn);
+	}
+private:
+	struct Node;
+	typedef std::shared_ptr<Node> Tree;
+	struct Node {
+		std::vector<Line> lines;
+		size_t count = 0;
+		unsigned priority = 0;
+		Tree left;
+		Tree right;
+	};
+	static size_t count(const Tree &t) { return t? t->count: 0; }
+	static Node *unshare(Tree &t);
+	static void update(Node *n);
+	static Tree merge(Tree a, Tree b);
+	void split(Tree t, size_t index, Tree &l, Tree &r);
+	Tree build(std::vector<Line> &&lines);
+	Tree make_node(std::vector<Line> &&lines);
+	template <typename F>
+	static void scan(const Tree &t, size_t begin, size_t end, F &fn) {
+		if (!t || begin >= end) return;
+		size_t lc = count(t->left);
+		size_t own = t->lines.size();
+		if (begin < lc) {
+			scan(t->left, begin, std::min(end, lc), fn);
+		}
+		for (size_t i = std::max(begin, lc); i < std::min(end, lc + own); ++i) {
+			fn(t->lines[i - lc]);
+		}
+		if (end > lc + own) {
+			size_t skip = lc + own;
+			scan(t->right, std::max(begin, skip) - skip, end - skip, fn);
+		}
+	}
+	Tree _root;
+	unsigned _seed = 0x2545F491;
+};
+} // namespace Editor
+
+#endif // EDITOR_ROPE_H
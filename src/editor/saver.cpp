@@ -0,0 +1,57 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/saver.h"
+#include <signal.h>
+#include <stdexcept>
+#include <unistd.h>
+
+Editor::Saver::Saver(
+		std::shared_ptr<Document::Snapshot> snap,
+		std::string path,
+		Durability durability):
+		_snapshot(snap),
+		_writer(new Writer(path, durability, snap->original.get())),
+		_done(false) {
+	_worker = std::thread(&Saver::run, this);
+}
+
+Editor::Saver::~Saver() {
+	wait();
+}
+
+void Editor::Saver::wait() {
+	if (_worker.joinable()) {
+		_worker.join();
+	}
+}
+
+void Editor::Saver::run() {
+	try {
+		const Rope &lines = _snapshot->lines;
+		lines.scan(0, lines.size(), [this](const Line &line) {
+			_writer->write(line);
+		});
+		_writer->commit();
+	} catch (const std::runtime_error &e) {
+		_error = e.what();
+	}
+	_writer.reset();
+	_done.store(true);
+	// Wake up the main loop so it can poll for the result.
+	kill(getpid(), SIGIO);
+}
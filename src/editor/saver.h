@@ -0,0 +1,52 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_SAVER_H
+#define EDITOR_SAVER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include "editor/document.h"
+#include "editor/writer.h"
+
+namespace Editor {
+// A saver writes a document snapshot to disk on a background thread, so the
+// editor can go on working while a big file is being written. The target file
+// is opened right away, so problems with the path show up immediately; any
+// error encountered while writing is reported once the saver is done.
+class Saver {
+public:
+	Saver(std::shared_ptr<Document::Snapshot> snap, std::string path,
+			Durability durability);
+	~Saver();
+	const Document::Snapshot &snapshot() const { return *_snapshot; }
+	bool done() const { return _done.load(); }
+	void wait();
+	std::string error() const { return _error; }
+private:
+	void run();
+	std::shared_ptr<Document::Snapshot> _snapshot;
+	std::unique_ptr<Writer> _writer;
+	std::string _error;
+	std::atomic_bool _done;
+	std::thread _worker;
+};
+} // namespace Editor
+
+#endif // EDITOR_SAVER_H
@@ -0,0 +1,196 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/tokencache.h"
+#include <algorithm>
+
+namespace {
+// The window only needs to be a few screens tall.
+const size_t kLimit = 1024;
+// A line longer than this is probably data, not code. We only parse the
+// visible part of such a line, starting in the state the line begins in,
+// and we don't let it open or close a block.
+const size_t kLongLine = 16 * 1024;
+// How much of a long line to parse on either side of the visible part, so
+// that scrolling a little doesn't mean parsing it all again.
+const size_t kMargin = 1024;
+}
+
+Editor::TokenCache::TokenCache(
+		const Document &doc, const Syntax::Grammar &grammar):
+		_doc(doc),
+		_grammar(grammar),
+		_has_blocks(grammar.has_blocks()),
+		_states(1, 0) {
+}
+
+const Syntax::Tokens &Editor::TokenCache::get(
+		line_t index, offset_t begin, offset_t end) {
+	// If this line is nowhere near the window, start a new one here.
+	line_t stop = _base + _entries.size();
+	if (_entries.empty() || index + kLimit < _base || index >= stop + kLimit) {
+		_entries.clear();
+		_base = index;
+	}
+	// Stretch the window until it includes this line, then trim entries off
+	// the far end if the window has grown too big.
+	while (index < _base) {
+		_entries.emplace_front();
+		--_base;
+	}
+	while (index >= _base + _entries.size()) {
+		_entries.emplace_back();
+	}
+	while (_entries.size() > kLimit) {
+		if (index - _base > _base + _entries.size() - 1 - index) {
+			_entries.pop_front();
+			++_base;
+		} else {
+			_entries.pop_back();
+		}
+	}
+	Entry &entry = _entries[index - _base];
+	const Line &text = _doc.line(index);
+	if (text.size() > kLongLine) {
+		end = std::min(end, text.size());
+		if (entry.valid && begin >= entry.begin && end <= entry.end) {
+			return entry.tokens;
+		}
+		begin -= std::min(begin, kMargin);
+		end = std::min(end + kMargin, text.size());
+	} else {
+		if (entry.valid) return entry.tokens;
+		begin = 0;
+		end = text.size();
+	}
+	Syntax::State state = entry_state(index);
+	entry.tokens = Syntax::parse(_grammar, text.substr(begin, end - begin), state);
+	for (auto &token: entry.tokens) {
+		token.begin += begin;
+		token.end += begin;
+	}
+	entry.begin = begin;
+	entry.end = end;
+	entry.valid = true;
+	return entry.tokens;
+}
+
+void Editor::TokenCache::lines_changed(
+		line_t index, line_t removed, line_t added) {
+	shift(index, removed, added);
+	// The lines before the change begin in the same states they always did,
+	// but the states after it must move along with their lines, and may
+	// have to be worked out again.
+	if (_has_blocks && index < _states.size()) {
+		std::vector<Syntax::State> old;
+		if (index + removed < _states.size()) {
+			old.assign(_states.begin() + index + removed, _states.end());
+		}
+		_states.resize(index + 1);
+		relex(index, added, std::move(old));
+	}
+}
+
+void Editor::TokenCache::shift(line_t index, line_t removed, line_t added) {
+	line_t end = _base + _entries.size();
+	// Changes after the window don't affect it; changes before the window
+	// just move it up or down.
+	if (index >= end) return;
+	line_t stop = std::min(index + removed, end);
+	if (index + removed <= _base) {
+		_base += added;
+		_base -= removed;
+		return;
+	}
+	// If the change overlaps the beginning of the window, the window now
+	// begins after the new lines, which we'd have to parse anyway.
+	if (index < _base) {
+		_entries.erase(_entries.begin(), _entries.begin() + (stop - _base));
+		_base = index + added;
+		return;
+	}
+	// Otherwise the change happened inside the window, so remove the entries
+	// for the old lines and make empty ones for the new lines. If that would
+	// make the window too big, just forget everything after the change.
+	auto pos = _entries.begin() + (index - _base);
+	_entries.erase(pos, pos + (stop - index));
+	if (_entries.size() + added > kLimit) {
+		_entries.resize(index - _base);
+		return;
+	}
+	if (added > 0) {
+		pos = _entries.begin() + (index - _base);
+		_entries.insert(pos, added, Entry());
+	}
+}
+
+bool Editor::TokenCache::restyled(line_t &begin, line_t &end) {
+	if (!_restyled) return false;
+	begin = _restyle_begin;
+	end = _restyle_end;
+	_restyled = false;
+	return true;
+}
+
+Syntax::State Editor::TokenCache::entry_state(line_t index) {
+	if (!_has_blocks) return 0;
+	// Work our way down from the last line whose state we know.
+	while (_states.size() <= index) {
+		line_t prev = _states.size() - 1;
+		_states.push_back(exit_state(prev, _states.back()));
+	}
+	return _states[index];
+}
+
+Syntax::State Editor::TokenCache::exit_state(line_t index, Syntax::State state) {
+	const Line &text = _doc.line(index);
+	if (text.size() > kLongLine) return state;
+	return Syntax::scan(_grammar, text.str(), state);
+}
+
+void Editor::TokenCache::relex(
+		line_t index, line_t added, std::vector<Syntax::State> &&old) {
+	// Work out the states of the new lines, then keep going through the
+	// following lines until one of them begins in the same state it did
+	// before the change, since nothing after that can have changed either.
+	// The old states belong to the lines beginning at index + added.
+	if (old.empty()) return;
+	line_t next = index + added;
+	for (line_t pos = index;; ++pos) {
+		if (pos >= next) {
+			size_t k = pos - next;
+			if (k >= old.size()) return;
+			if (old[k] == _states[pos]) {
+				_states.insert(_states.end(), old.begin() + k + 1, old.end());
+				return;
+			}
+			forget(pos);
+		}
+		if (pos >= _doc.maxline()) return;
+		_states.push_back(exit_state(pos, _states[pos]));
+	}
+}
+
+void Editor::TokenCache::forget(line_t index) {
+	// This line now begins in a different state, so it will look different.
+	if (index >= _base && index < _base + _entries.size()) {
+		_entries[index - _base].valid = false;
+	}
+	_restyle_begin = _restyled? std::min(_restyle_begin, index): index;
+	_restyle_end = _restyled? std::max(_restyle_end, index): index;
+	_restyled = true;
+}
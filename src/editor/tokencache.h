@@ -0,0 +1,75 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_TOKENCACHE_H
+#define EDITOR_TOKENCACHE_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "app/syntax.h"
+#include "editor/document.h"
+
+namespace Editor {
+// The token cache remembers how the lines around the visible part of the
+// document were parsed, so that repainting, scrolling, and moving the cursor
+// don't have to parse anything again. It watches the document so it can
+// forget about lines which have been edited and keep up with lines which
+// have moved because other lines were inserted or removed above them.
+// Since a block comment or string can span many lines, the cache also keeps
+// track of the state each line begins in, from the top of the document down
+// to the furthest line anyone has asked about.
+class TokenCache : public Document::Observer {
+public:
+	TokenCache(const Document &doc, const Syntax::Grammar &grammar);
+	// Get tokens covering at least this part of the line. Normal lines are
+	// parsed all at once, but for a very long line, we only parse the part
+	// which is on screen, plus a margin.
+	const Syntax::Tokens &get(line_t index, offset_t begin, offset_t end);
+	virtual void lines_changed(
+			line_t index, line_t removed, line_t added) override;
+	// Did an edit change the way some lines beyond the edit will look, by
+	// opening or closing a block? If so, which lines were affected?
+	bool restyled(line_t &begin, line_t &end);
+private:
+	void shift(line_t index, line_t removed, line_t added);
+	Syntax::State entry_state(line_t index);
+	Syntax::State exit_state(line_t index, Syntax::State state);
+	void relex(line_t index, line_t added, std::vector<Syntax::State> &&old);
+	void forget(line_t index);
+	struct Entry {
+		bool valid = false;
+		Syntax::Tokens tokens;
+		// Which part of the line do the tokens cover?
+		offset_t begin = 0;
+		offset_t end = 0;
+	};
+	const Document &_doc;
+	const Syntax::Grammar &_grammar;
+	bool _has_blocks;
+	// The entries describe a window of consecutive lines beginning at _base.
+	line_t _base = 0;
+	std::deque<Entry> _entries;
+	// The state in which each line begins, as far down as we have looked.
+	std::vector<Syntax::State> _states;
+	bool _restyled = false;
+	line_t _restyle_begin = 0;
+	line_t _restyle_end = 0;
+};
+} // namespace Editor
+
+#endif // EDITOR_TOKENCACHE_H
@@ -16,12 +16,12 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include "editor/update.h"
+#include <algorithm>
 #include <climits>
 
 void Editor::Update::reset() {
-	_dirty = false;
-	_start = 0;
-	_end = 0;
+	_spans.clear();
+	_shifts.clear();
 }
 
 void Editor::Update::at(location_t loc) {
@@ -29,33 +29,65 @@ void Editor::Update::at(location_t loc) {
 }
 
 void Editor::Update::at(line_t index) {
-	_start = _dirty? std::min(_start, index): index;
-	_end = _dirty? std::max(_end, index): index;
-	_dirty = true;
+	mark(index, index + 1);
 }
 
 void Editor::Update::range(const Range &range) {
 	line_t a = range.begin().line;
 	line_t b = range.end().line;
-	line_t from = std::min(a, b);
-	line_t to = std::max(a, b);
-	_start = _dirty? std::min(_start, from): from;
-	_end = _dirty? std::max(_end, to): to;
-	_dirty = true;
+	mark(std::min(a, b), std::max(a, b) + 1);
 }
 
-void Editor::Update::forward(location_t loc) {
-	_start = _dirty? std::min(_start, loc.line): loc.line;
-	_end = SIZE_MAX;
-	_dirty = true;
+void Editor::Update::all() {
+	// Everything will be repainted, so there is nothing worth moving.
+	_spans.clear();
+	_spans.push_back(span_t{0, SIZE_MAX});
+	_shifts.clear();
 }
 
-void Editor::Update::all() {
-	_dirty = true;
-	_start = 0;
-	_end = SIZE_MAX;
+void Editor::Update::lines_changed(
+		line_t index, line_t removed, line_t added) {
+	line_t gone = index + removed;
+	if (removed != added) {
+		// Spans which began after the edit move along with their lines;
+		// spans inside the removed lines go away with them.
+		std::vector<span_t> spans;
+		for (auto &span: _spans) {
+			if (span.begin < index) {
+				spans.push_back(span_t{span.begin, std::min(span.end, index)});
+			}
+			if (span.end > gone) {
+				line_t begin = std::max(span.begin, gone) - removed + added;
+				line_t end = span.end;
+				if (end != SIZE_MAX) end = end - removed + added;
+				spans.push_back(span_t{begin, end});
+			}
+		}
+		_spans.swap(spans);
+		line_t same = std::min(removed, added);
+		_shifts.push_back(shift_t{index + same, (long)added - (long)removed});
+	}
+	mark(index, index + added);
 }
 
 bool Editor::Update::is_dirty(line_t index) const {
-	return _dirty && (index >= _start) && (index <= _end);
+	auto iter = std::upper_bound(_spans.begin(), _spans.end(), index,
+			[](line_t i, const span_t &span) { return i < span.end; });
+	return iter != _spans.end() && iter->begin <= index;
+}
+
+void Editor::Update::mark(line_t begin, line_t end) {
+	if (begin >= end) return;
+	// Find the spans this one touches, then replace them all with a single
+	// span covering their union.
+	auto first = std::lower_bound(_spans.begin(), _spans.end(), begin,
+			[](const span_t &span, line_t i) { return span.end < i; });
+	auto last = first;
+	while (last != _spans.end() && last->begin <= end) {
+		begin = std::min(begin, last->begin);
+		end = std::max(end, last->end);
+		++last;
+	}
+	first = _spans.erase(first, last);
+	_spans.insert(first, span_t{begin, end});
 }
@@ -18,23 +18,41 @@
 #ifndef EDITOR_UPDATE_H
 #define EDITOR_UPDATE_H
 
+#include <vector>
 #include "editor/coordinates.h"
 
 namespace Editor {
+// Which lines must be repainted? Damage is kept as a sorted list of disjoint
+// spans, so that marking two distant lines does not also mark all the lines
+// between them. Lines inserted or deleted by an edit are remembered as shifts,
+// so the painter can move what is already on screen instead of redrawing it.
 class Update {
 public:
+	Update() { all(); }
 	void reset();
 	void at(location_t loc);
 	void at(line_t line);
 	void range(const Range &range);
-	void forward(location_t loc);
 	void all();
-	bool has_dirty() const { return _dirty; }
+	// Beginning at this index, some lines were replaced by some number of
+	// new lines; the new ones are dirty and the rest move along.
+	void lines_changed(line_t index, line_t removed, line_t added);
+	bool has_dirty() const { return !_spans.empty(); }
 	bool is_dirty(line_t index) const;
+	// Before this line, count lines were inserted, or deleted if negative.
+	struct shift_t {
+		line_t line;
+		long count;
+	};
+	const std::vector<shift_t> &shifts() const { return _shifts; }
 private:
-	bool _dirty = true;
-	line_t _start = 0;
-	line_t _end = 0;
+	void mark(line_t begin, line_t end);
+	struct span_t {
+		line_t begin;
+		line_t end;
+	};
+	std::vector<span_t> _spans;
+	std::vector<shift_t> _shifts;
 };
 } // namespace Editor
 
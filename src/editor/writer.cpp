@@ -0,0 +1,187 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "editor/writer.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const size_t kStagingSize = 1 << 16;
+const size_t kMaxStagedLine = 1 << 10;
+const size_t kMaxIOV = IOV_MAX;
+char linebreak[] = {'\x0A'};
+}
+
+Editor::Writer::Writer(std::string path, Durability durability, Mapping *src):
+		_durability(durability),
+		_original(src),
+		_staging(kStagingSize) {
+	// If the target is a symlink, we want to replace the file it refers to,
+	// not the link itself.
+	char *real = realpath(path.c_str(), nullptr);
+	if (real) {
+		path = real;
+		free(real);
+	}
+	_path = path;
+	size_t slashpos = path.find_last_of('/');
+	std::string dir = (slashpos != std::string::npos)?
+			path.substr(0, slashpos + 1): std::string();
+	std::string name = path.substr(dir.size());
+	// Replacing the file only takes permission to write in its directory,
+	// but the user should not be able to save over a file they couldn't
+	// write to directly.
+	struct stat st;
+	bool exists = 0 == stat(path.c_str(), &st);
+	if (exists && access(path.c_str(), W_OK)) fail();
+	std::string temp = dir + "." + name + ".XXXXXX";
+	_fd = mkstemp(&temp[0]);
+	if (_fd >= 0) {
+		// The temporary file should end up with the same permissions as the
+		// file it replaces, or the usual permissions for a new file.
+		_temppath = temp;
+		mode_t mode = exists? (st.st_mode & 07777): 0;
+		if (!exists) {
+			mode_t mask = umask(0);
+			umask(mask);
+			mode = 0666 & ~mask;
+		}
+		fchmod(_fd, mode);
+		if (exists && fchown(_fd, st.st_uid, st.st_gid)) {
+			// Not the owner? Then the file will belong to us; oh well.
+		}
+		return;
+	}
+	// If we aren't allowed to create files in the target's directory, we'll
+	// have to overwrite the file in place. If the lines we are going to write
+	// still refer to that file, they must be copied aside first.
+	if (exists && src && src->is(st) && !src->detach()) fail();
+	_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (_fd < 0) fail();
+}
+
+Editor::Writer::~Writer() {
+	if (_fd >= 0) close(_fd);
+	if (!_temppath.empty()) unlink(_temppath.c_str());
+}
+
+void Editor::Writer::write(const Line &line) {
+	const char *data = line.data();
+	size_t size = line.size();
+	// If this line still refers to the original file, and the original file
+	// has a plain linebreak after it, we can write both straight from the
+	// mapping. If the previous chunk we wrote ended where this one begins,
+	// we can simply extend it.
+	if (!line.edited() && _original && data + size < _original->end() &&
+			data[size] == '\x0A') {
+		if (!_iov.empty()) {
+			struct iovec &last = _iov.back();
+			if (static_cast<char*>(last.iov_base) + last.iov_len == data) {
+				last.iov_len += size + 1;
+				return;
+			}
+		}
+		if (_iov.size() >= kMaxIOV) flush();
+		_iov.push_back({const_cast<char*>(data), size + 1});
+		return;
+	}
+	// Short lines go into the staging buffer, which we'll write out as a
+	// single chunk. Longer lines are written from wherever they live.
+	if (size <= kMaxStagedLine) {
+		if (_staged + size + 1 > _staging.size() || _iov.size() + 1 >= kMaxIOV) {
+			flush();
+		}
+		char *dest = &_staging[_staged];
+		memcpy(dest, data, size);
+		dest[size] = '\x0A';
+		_staged += size + 1;
+		if (!_iov.empty()) {
+			struct iovec &last = _iov.back();
+			if (static_cast<char*>(last.iov_base) + last.iov_len == dest) {
+				last.iov_len += size + 1;
+				return;
+			}
+		}
+		_iov.push_back({dest, size + 1});
+		return;
+	}
+	if (_iov.size() + 2 > kMaxIOV) flush();
+	_iov.push_back({const_cast<char*>(data), size});
+	_iov.push_back({linebreak, 1});
+}
+
+void Editor::Writer::commit() {
+	flush();
+	if (_durability != Durability::None && fsync(_fd)) fail();
+	if (close(_fd)) {
+		_fd = -1;
+		fail();
+	}
+	_fd = -1;
+	if (_temppath.empty()) return;
+	if (rename(_temppath.c_str(), _path.c_str())) fail();
+	_temppath.clear();
+	if (_durability != Durability::Full) return;
+	// Make sure the directory entry for the new file has hit the disk too.
+	size_t slashpos = _path.find_last_of('/');
+	std::string dir = (slashpos != std::string::npos)?
+			_path.substr(0, slashpos + 1): std::string(".");
+	int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0) fail();
+	int err = fsync(dirfd);
+	close(dirfd);
+	if (err) fail();
+}
+
+void Editor::Writer::flush() {
+	// Keep calling writev until everything we have queued has been written,
+	// since the system may not accept it all in one go.
+	struct iovec *iov = _iov.data();
+	size_t count = _iov.size();
+	while (count > 0) {
+		ssize_t actual = writev(_fd, iov, count);
+		if (actual < 0) {
+			if (errno == EINTR) continue;
+			fail();
+		}
+		size_t done = actual;
+		while (count > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			++iov;
+			--count;
+		}
+		if (count > 0) {
+			iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+			iov->iov_len -= done;
+		}
+	}
+	_iov.clear();
+	_staged = 0;
+}
+
+void Editor::Writer::fail() {
+	int local_errno = errno;
+	std::string err = "Failed to write (" + std::to_string(local_errno);
+	err += ": " + std::string(std::strerror(local_errno)) + ")";
+	throw std::runtime_error(err);
+}
@@ -0,0 +1,71 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef EDITOR_WRITER_H
+#define EDITOR_WRITER_H
+
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#include "editor/line.h"
+#include "editor/mapping.h"
+
+namespace Editor {
+// How hard should we try to make sure a saved file survives a system crash?
+// The rename alone protects against our own untimely demise; syncing the file
+// protects its contents against power loss, and syncing the directory also
+// protects the rename itself.
+enum class Durability {
+	None,
+	File,
+	Full
+};
+
+// A writer saves lines of text to a file without ever leaving a partially
+// written file behind. The text goes into a temporary file in the same
+// directory, which replaces the target only once all of the text has been
+// written. We gather lines into large batches and write them with writev;
+// runs of unedited lines which still refer to the original file go out
+// straight from the mapped bytes, without being copied at all.
+class Writer {
+public:
+	Writer(std::string path, Durability durability, Mapping *original);
+	Writer(const Writer&) = delete;
+	Writer &operator=(const Writer&) = delete;
+	~Writer();
+	// Append this line to the file, followed by a linebreak.
+	void write(const Line &line);
+	// Flush everything and move the finished file into place.
+	void commit();
+private:
+	void flush();
+	void fail();
+	std::string _path;
+	std::string _temppath;
+	Durability _durability;
+	const Mapping *_original;
+	int _fd = -1;
+	std::vector<struct iovec> _iov;
+	// Short lines are copied into a staging buffer instead of being given an
+	// iovec of their own, so the number of system calls depends on the size
+	// of the file and not on the number of lines it contains.
+	std::vector<char> _staging;
+	size_t _staged = 0;
+};
+} // namespace Editor
+
+#endif // EDITOR_WRITER_H
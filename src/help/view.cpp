@@ -71,7 +71,9 @@ Help::View::~View() {
 void Help::View::paint_into(WINDOW *view, State state) {
 	wmove(view, 0, 0);
 	getmaxyx(view, _height, _width);
+	auto dirty = scroll_to(view, state, _scrollpos);
 	for (int row = 0; row < _height; ++row) {
+		if (!dirty[row]) continue;
 		wmove(view, row, 0);
 		size_t i = row + _scrollpos;
 		if (i > 0 && i < helplines.size()) {
@@ -16,6 +16,7 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include "app/ozette.h"
+#include "app/reactor.h"
 #include <signal.h>
 #include <stdlib.h>
 #include <locale.h>
@@ -27,15 +28,20 @@ static void handle_sigint(int) {
 	exit(EXIT_SUCCESS);
 }
 
-static void handle_sigio(int) {
-	s_app->sig_io();
-}
-
 int main(int argc, char **argv) {
 	setlocale(LC_ALL, "");
 	(void)signal(SIGINT, handle_sigint);
 	(void)signal(SIGPIPE, SIG_IGN);
-	(void)signal(SIGIO, handle_sigio);
+	// Background tasks wake the main loop with SIGIO; the main loop also
+	// hears about subprocesses exiting and the terminal changing size.
+	// These all arrive through the reactor, so they must be blocked before
+	// any other thread starts.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGIO);
+	sigaddset(&signals, SIGCHLD);
+	sigaddset(&signals, SIGWINCH);
+	Reactor::block(signals);
 	s_app.reset(new Ozette);
 	for (int i = 1; i < argc; ++i) {
 		s_app->edit_file(argv[i]);
@@ -0,0 +1,313 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "search/engine.h"
+#include <chrono>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <signal.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "search/substring.h"
+
+namespace {
+// Like grep -I, we skip files which have a NUL somewhere near the beginning.
+const size_t kBinaryProbe = 32 * 1024;
+
+// Does this needle use any of the basic regular expression operators? If
+// not, we can look for it with a simple substring search.
+bool is_literal(const std::string &needle) {
+	return needle.find_first_of("\\.[]*^$") == std::string::npos;
+}
+
+// Search results are meant for display, so we keep only printable text.
+std::string printable(const char *begin, const char *end) {
+	std::string out;
+	for (const char *pos = begin; pos < end; ++pos) {
+		if (isprint((unsigned char)*pos)) out.push_back(*pos);
+	}
+	return out;
+}
+} // namespace
+
+Search::Engine::Engine(spec job, std::shared_ptr<Index> index):
+		_job(job),
+		_literal(is_literal(job.needle)),
+		_index(index),
+		_pending(0),
+		_running(true),
+		_cancel(false),
+		_signalled(false) {
+	if (_job.haystack.empty()) _job.haystack = ".";
+	if (_job.filter.empty()) _job.filter = "*";
+	_prefix = _job.haystack;
+	if (_prefix.back() != '/') _prefix.push_back('/');
+	if (!_literal) {
+		regex_t re;
+		int err = regcomp(&re, _job.needle.c_str(), REG_NEWLINE);
+		if (err) {
+			char buf[256];
+			regerror(err, &re, buf, sizeof(buf));
+			throw std::runtime_error(buf);
+		}
+		regfree(&re);
+		// Lines which lack the longest literal part of the expression
+		// cannot match, so we look for it before running the matcher.
+		for (auto &str: literals(_job.needle)) {
+			if (str.size() > _required.size()) _required = str;
+		}
+	}
+	unsigned count = std::thread::hardware_concurrency();
+	if (count == 0) count = 2;
+	for (unsigned i = 0; i < count; ++i) {
+		_workers.emplace_back(new worker);
+	}
+	_driver = std::thread(&Engine::drive, this);
+}
+
+Search::Engine::~Engine() {
+	_cancel = true;
+	_driver.join();
+}
+
+bool Search::Engine::take(std::vector<file> &out) {
+	_signalled = false;
+	bool any = false;
+	file item;
+	while (_results.pop(item)) {
+		out.push_back(std::move(item));
+		any = true;
+	}
+	return any;
+}
+
+void Search::Engine::drive() {
+	struct stat st;
+	bool dir = 0 == stat(_job.haystack.c_str(), &st) && S_ISDIR(st.st_mode);
+	if (_index && dir) {
+		// Visit every file in the tree, reindexing those which have changed,
+		// then search only the files which might contain a match.
+		_refreshing = true;
+		_index->begin_refresh();
+		push_task(0, task{_job.haystack, true});
+		run_workers();
+		_refreshing = false;
+		if (!_cancel) {
+			_index->end_refresh();
+			size_t id = 0;
+			for (auto &path: _index->candidates(_job.needle)) {
+				size_t slash = path.find_last_of('/');
+				const char *name = path.c_str() + (slash == std::string::npos? 0: slash + 1);
+				if (fnmatch(_job.filter.c_str(), name, 0)) continue;
+				push_task(id++ % _workers.size(), task{_prefix + path, false});
+			}
+		}
+	} else {
+		push_task(0, task{_job.haystack, dir});
+	}
+	run_workers();
+	// Let the main loop know we are done.
+	_running = false;
+	if (!_signalled.exchange(true)) {
+		kill(getpid(), SIGIO);
+	}
+}
+
+void Search::Engine::run_workers() {
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		_workers[i]->thread = std::thread(&Engine::run, this, i);
+	}
+	for (auto &w: _workers) {
+		w->thread.join();
+	}
+}
+
+void Search::Engine::run(size_t id) {
+	regex_t re;
+	if (!_literal) {
+		regcomp(&re, _job.needle.c_str(), REG_NEWLINE);
+	}
+	task job;
+	while (!_cancel) {
+		if (next_task(id, job)) {
+			if (job.directory) {
+				scan_dir(id, job.path);
+			} else if (_refreshing) {
+				index_file(job.path);
+			} else {
+				scan_file(job.path, _literal? nullptr: &re);
+			}
+			--_pending;
+		} else if (_pending == 0) {
+			break;
+		} else {
+			// Everything left is already in progress elsewhere, but it
+			// may yet produce more work for us.
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	if (!_literal) {
+		regfree(&re);
+	}
+}
+
+bool Search::Engine::next_task(size_t id, task &out) {
+	// Take the most recent task from our own queue, which keeps the
+	// traversal depth-first, or else steal the oldest from another worker.
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		worker &w = *_workers[(id + i) % _workers.size()];
+		std::lock_guard<std::mutex> lock(w.mutex);
+		if (w.tasks.empty()) continue;
+		if (i == 0) {
+			out = std::move(w.tasks.back());
+			w.tasks.pop_back();
+		} else {
+			out = std::move(w.tasks.front());
+			w.tasks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+void Search::Engine::push_task(size_t id, task &&job) {
+	++_pending;
+	worker &w = *_workers[id];
+	std::lock_guard<std::mutex> lock(w.mutex);
+	w.tasks.push_back(std::move(job));
+}
+
+void Search::Engine::scan_dir(size_t id, const std::string &path) {
+	DIR *dir = opendir(path.c_str());
+	if (!dir) return;
+	std::string prefix = path;
+	if (prefix.back() != '/') prefix.push_back('/');
+	while (struct dirent *entry = readdir(dir)) {
+		if (_cancel) break;
+		const char *name = entry->d_name;
+		if (!strcmp(name, ".") || !strcmp(name, "..")) continue;
+		std::string child = prefix + name;
+		unsigned char type = entry->d_type;
+		if (type == DT_UNKNOWN) {
+			struct stat st;
+			if (lstat(child.c_str(), &st)) continue;
+			if (S_ISDIR(st.st_mode)) type = DT_DIR;
+			else if (S_ISREG(st.st_mode)) type = DT_REG;
+		}
+		// Like grep -r, we do not follow symlinks found along the way.
+		if (type == DT_DIR) {
+			push_task(id, task{child, true});
+		} else if (type != DT_REG) {
+			continue;
+		} else if (_refreshing || 0 == fnmatch(_job.filter.c_str(), name, 0)) {
+			push_task(id, task{child, false});
+		}
+	}
+	closedir(dir);
+}
+
+void Search::Engine::index_file(const std::string &path) {
+	std::string rel = path.substr(_prefix.size());
+	struct stat st;
+	if (stat(path.c_str(), &st) || _index->current(rel, st)) return;
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	size_t size = st.st_size;
+	void *addr = size? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0): nullptr;
+	close(fd);
+	if (addr == MAP_FAILED) return;
+	_index->update(rel, st, static_cast<const char*>(addr), size);
+	if (addr) munmap(addr, size);
+}
+
+void Search::Engine::scan_file(const std::string &path, const regex_t *re) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	struct stat st;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return;
+	}
+	size_t size = st.st_size;
+	void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return;
+	const char *begin = static_cast<const char*>(addr);
+	const char *end = begin + size;
+	file found{path, {}};
+	if (!memchr(begin, '\0', std::min(size, kBinaryProbe))) {
+		// Line numbers are counted lazily, up to each match we report.
+		size_t index = 0;
+		const char *counted = begin;
+		const char *line = begin;
+		while (line < end) {
+			const char *hit = line;
+			if (re && !_required.empty()) {
+				hit = substring(line, end, _required);
+				if (!hit) break;
+				const char *bol = hit;
+				while (bol > line && bol[-1] != '\n') --bol;
+				const char *eol = (const char*)memchr(hit, '\n', end - hit);
+				if (!eol) eol = end;
+				regmatch_t range;
+				range.rm_so = 0;
+				range.rm_eo = eol - bol;
+				if (regexec(re, bol, 1, &range, REG_STARTEND)) {
+					line = eol + 1;
+					continue;
+				}
+			} else if (re) {
+				// Let the matcher scan the rest of the file in one go; with
+				// REG_NEWLINE, no match can span a line break.
+				regmatch_t range;
+				range.rm_so = 0;
+				range.rm_eo = end - line;
+				if (regexec(re, line, 1, &range, REG_STARTEND)) break;
+				hit = line + range.rm_so;
+				// An empty match after the final newline is not a line.
+				if (hit == end && end[-1] == '\n') break;
+			} else if (!_job.needle.empty()) {
+				hit = substring(line, end, _job.needle);
+				if (!hit) break;
+			}
+			// Back up to the start of the line containing the hit and
+			// report the whole line, once, however many times it matches.
+			const char *bol = hit;
+			while (bol > line && bol[-1] != '\n') --bol;
+			const char *eol = (const char*)memchr(hit, '\n', end - hit);
+			if (!eol) eol = end;
+			for (; counted < bol; ++counted) {
+				counted = (const char*)memchr(counted, '\n', bol - counted);
+				if (!counted) break;
+				++index;
+			}
+			counted = bol;
+			found.matches.push_back(match{index, printable(bol, eol)});
+			line = eol + 1;
+		}
+	}
+	munmap(addr, size);
+	if (found.matches.empty()) return;
+	_results.push(std::move(found));
+	if (!_signalled.exchange(true)) {
+		kill(getpid(), SIGIO);
+	}
+}
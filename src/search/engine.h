@@ -1,5 +1,5 @@
 // ozette
-// Copyright (C) 2015-2016 Mars J. Saxman
+// Copyright (C) 2014-2016 Mars J. Saxman
 //
 // This program is free software; you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,7 +18,16 @@
 #ifndef SEARCH_ENGINE_H
 #define SEARCH_ENGINE_H
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <regex.h>
 #include <string>
+#include <thread>
+#include <vector>
+#include "search/index.h"
+#include "search/queue.h"
 
 namespace Search {
 // What should we look for?
@@ -27,6 +36,68 @@ struct spec {
 	std::string haystack;
 	std::string filter;
 };
+
+// What did we find? Matches are grouped by file; line indexes are zero-based.
+struct match {
+	size_t index;
+	std::string text;
+};
+struct file {
+	std::string path;
+	std::vector<match> matches;
+};
+
+// The engine searches a directory tree for lines matching the needle, which
+// is a basic regular expression, as with grep. Files whose names match the
+// filter are mapped into memory and searched; binary files are skipped. The
+// work is spread across a pool of threads, each with its own queue of
+// directories and files to search; an idle thread steals work from the
+// others. Results come back through a lock-free queue, one file at a time.
+// Given an index for the haystack, the engine brings the index up to date,
+// then searches only those files which the index says might match.
+class Engine {
+public:
+	// Throws std::runtime_error if the needle is not a valid expression.
+	Engine(spec job, std::shared_ptr<Index> index = nullptr);
+	Engine(const Engine&) = delete;
+	Engine &operator=(const Engine&) = delete;
+	~Engine();
+	// Is the search still underway?
+	bool running() const { return _running; }
+	// Collect the results found since the last time we asked.
+	bool take(std::vector<file> &out);
+private:
+	struct task {
+		std::string path;
+		bool directory;
+	};
+	struct worker {
+		std::mutex mutex;
+		std::deque<task> tasks;
+		std::thread thread;
+	};
+	void drive();
+	void run_workers();
+	void run(size_t id);
+	bool next_task(size_t id, task &out);
+	void push_task(size_t id, task &&job);
+	void scan_dir(size_t id, const std::string &path);
+	void scan_file(const std::string &path, const regex_t *re);
+	void index_file(const std::string &path);
+	spec _job;
+	std::string _prefix;
+	bool _literal;
+	std::string _required;
+	std::shared_ptr<Index> _index;
+	bool _refreshing = false;
+	std::vector<std::unique_ptr<worker>> _workers;
+	std::thread _driver;
+	std::atomic<size_t> _pending;
+	std::atomic<bool> _running;
+	std::atomic<bool> _cancel;
+	std::atomic<bool> _signalled;
+	Queue<file> _results;
+};
 } // namespace Search
 
 #endif //SEARCH_ENGINE_H
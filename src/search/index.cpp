@@ -0,0 +1,342 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "search/index.h"
+#include <algorithm>
+#include <iterator>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+// Like grep -I, we treat files with a NUL near the beginning as binary.
+const size_t kBinaryProbe = 32 * 1024;
+// Larger files are not indexed, so every query must search them.
+const size_t kLargeFile = 8 * 1024 * 1024;
+const char kFormat[] = "ozette trigram index 1";
+
+// Trigrams never span lines, because matches never do.
+std::vector<Search::Index::trigram> extract(const char *text, size_t size) {
+	std::vector<Search::Index::trigram> out;
+	Search::Index::trigram gram = 0;
+	size_t run = 0;
+	for (size_t i = 0; i < size; ++i) {
+		unsigned char ch = text[i];
+		if (ch == '\n') {
+			run = 0;
+			continue;
+		}
+		gram = ((gram << 8) | ch) & 0xFFFFFF;
+		if (++run >= 3) out.push_back(gram);
+	}
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+	return out;
+}
+
+int64_t mtime(const struct stat &st) {
+	return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+} // namespace
+
+std::vector<std::string> Search::literals(const std::string &needle) {
+	// Anything we are not sure about simply ends the current string, since
+	// requiring too little is harmless.
+	std::vector<std::string> out(1);
+	unsigned depth = 0;
+	auto cut = [&out]() {
+		if (!out.back().empty()) out.emplace_back();
+	};
+	for (size_t i = 0; i < needle.size(); ++i) {
+		char ch = needle[i];
+		if (ch == '\\' && i + 1 < needle.size()) {
+			ch = needle[++i];
+			if (ch == '|') {
+				// With alternation, no particular string is required.
+				return std::vector<std::string>();
+			} else if (ch == '(') {
+				// A group may be repeated or made optional, so we ignore
+				// its contents.
+				depth++;
+				cut();
+			} else if (ch == ')') {
+				if (depth > 0) depth--;
+				cut();
+			} else if (ch == '?' || ch == '{') {
+				// The preceding character may occur zero times.
+				if (!out.back().empty()) out.back().pop_back();
+				cut();
+				if (ch == '{') {
+					size_t end = needle.find("\\}", i);
+					i = (end == std::string::npos)? needle.size(): end + 1;
+				}
+			} else if (strchr(".[]*^$\\/", ch)) {
+				if (depth == 0) out.back().push_back(ch);
+			} else {
+				cut();
+			}
+		} else if (ch == '*' && i > 0 && !(i == 1 && needle[0] == '^')) {
+			// The preceding character may occur zero times.
+			if (!out.back().empty()) out.back().pop_back();
+			cut();
+		} else if (ch == '[') {
+			// Skip over the bracket expression; a ']' which comes first
+			// is part of the set.
+			size_t end = i + 1;
+			if (end < needle.size() && needle[end] == '^') end++;
+			if (end < needle.size() && needle[end] == ']') end++;
+			end = needle.find(']', end);
+			i = (end == std::string::npos)? needle.size(): end;
+			cut();
+		} else if (ch == '.' || (ch == '^' && i == 0)) {
+			cut();
+		} else if (ch == '$' && i + 1 == needle.size()) {
+			cut();
+		} else if (depth == 0) {
+			out.back().push_back(ch);
+		}
+	}
+	return out;
+}
+
+Search::Index::Index(std::string root):
+		_root(root) {
+}
+
+std::string Search::Index::cache_name() const {
+	// FNV-1a, so the name stays the same from one build to the next.
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char ch: _root) {
+		hash = (hash ^ ch) * 1099511628211ULL;
+	}
+	char buf[17];
+	snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+	return std::string("trigrams-") + buf;
+}
+
+void Search::Index::load(const std::vector<std::string> &lines) {
+	// The cache contains the format and root, the number of files, one line
+	// for each file, then one line for each trigram listing the files which
+	// contain it, as differences from the previous file number.
+	std::lock_guard<std::mutex> lock(_mutex);
+	_files.clear();
+	_ids.clear();
+	_postings.clear();
+	_dead = 0;
+	if (lines.size() < 3 || lines[0] != kFormat || lines[1] != _root) return;
+	size_t count = strtoul(lines[2].c_str(), nullptr, 10);
+	if (lines.size() < 3 + count) return;
+	for (size_t i = 0; i < count; ++i) {
+		const char *pos = lines[3 + i].c_str();
+		char *next = nullptr;
+		entry file;
+		file.mtime = strtoll(pos, &next, 10);
+		file.size = strtoll(next, &next, 10);
+		if (*next++ != ' ' || !*next) goto corrupt;
+		file.type = (kind)*next++;
+		if (!strchr("TBL", file.type) || *next++ != ' ') goto corrupt;
+		file.path = next;
+		file.live = true;
+		_ids[file.path] = _files.size();
+		_files.push_back(std::move(file));
+	}
+	for (size_t i = 3 + count; i < lines.size(); ++i) {
+		const char *pos = lines[i].c_str();
+		char *next = nullptr;
+		trigram gram = strtoul(pos, &next, 16);
+		auto &list = _postings[gram];
+		uint32_t id = 0;
+		while (*next) {
+			id += strtoul(next, &next, 10);
+			if (id >= _files.size()) goto corrupt;
+			list.push_back(id);
+		}
+	}
+	return;
+corrupt:
+	// Start over from nothing; the next refresh will rebuild it all.
+	_files.clear();
+	_ids.clear();
+	_postings.clear();
+}
+
+void Search::Index::save(std::vector<std::string> &lines) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	compact();
+	lines.clear();
+	lines.push_back(kFormat);
+	lines.push_back(_root);
+	lines.push_back(std::to_string(_files.size()));
+	for (auto &file: _files) {
+		std::string line = std::to_string(file.mtime);
+		line += " " + std::to_string(file.size);
+		line += " " + std::string(1, (char)file.type);
+		// A path containing a newline cannot be stored; the entry will be
+		// dropped and the file indexed again on the next refresh.
+		line += " ";
+		if (file.path.find('\n') == std::string::npos) line += file.path;
+		lines.push_back(std::move(line));
+	}
+	char buf[16];
+	for (auto &pair: _postings) {
+		snprintf(buf, sizeof(buf), "%06x", pair.first);
+		std::string line = buf;
+		uint32_t prev = 0;
+		for (uint32_t id: pair.second) {
+			line += " " + std::to_string(id - prev);
+			prev = id;
+		}
+		lines.push_back(std::move(line));
+	}
+	_dirty = false;
+}
+
+void Search::Index::begin_refresh() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_seen.assign(_files.size(), false);
+}
+
+bool Search::Index::current(const std::string &path, const struct stat &st) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto iter = _ids.find(path);
+	if (iter == _ids.end()) return false;
+	entry &file = _files[iter->second];
+	if (file.mtime != mtime(st) || file.size != st.st_size) return false;
+	_seen[iter->second] = true;
+	return true;
+}
+
+void Search::Index::update(
+		const std::string &path, const struct stat &st,
+		const char *text, size_t size) {
+	entry file = {path, mtime(st), st.st_size, Text, true};
+	std::vector<trigram> grams;
+	if (size > kLargeFile) {
+		file.type = Large;
+	} else if (memchr(text, '\0', std::min(size, kBinaryProbe))) {
+		file.type = Binary;
+	} else {
+		grams = extract(text, size);
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto iter = _ids.find(path);
+	if (iter != _ids.end()) {
+		_files[iter->second].live = false;
+		_dead++;
+	}
+	// File numbers only ever increase, so the posting lists stay sorted.
+	uint32_t id = _files.size();
+	_ids[path] = id;
+	_files.push_back(std::move(file));
+	_seen.push_back(true);
+	for (trigram gram: grams) {
+		_postings[gram].push_back(id);
+	}
+	_dirty = true;
+}
+
+void Search::Index::end_refresh() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (size_t id = 0; id < _files.size(); ++id) {
+		if (_seen[id] || !_files[id].live) continue;
+		_files[id].live = false;
+		_ids.erase(_files[id].path);
+		_dead++;
+		_dirty = true;
+	}
+	_seen.clear();
+	if (_dead > _files.size() / 2) compact();
+}
+
+std::vector<std::string> Search::Index::candidates(const std::string &needle) {
+	std::vector<trigram> grams;
+	for (auto &str: literals(needle)) {
+		auto more = extract(str.data(), str.size());
+		grams.insert(grams.end(), more.begin(), more.end());
+	}
+	std::sort(grams.begin(), grams.end());
+	grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+	std::lock_guard<std::mutex> lock(_mutex);
+	// Intersect the posting lists, beginning with the shortest ones, which
+	// shrink the set of candidates fastest.
+	std::vector<const std::vector<uint32_t>*> lists;
+	for (trigram gram: grams) {
+		auto iter = _postings.find(gram);
+		if (iter == _postings.end()) {
+			lists.clear();
+			lists.push_back(nullptr);
+			break;
+		}
+		lists.push_back(&iter->second);
+	}
+	std::vector<uint32_t> ids;
+	if (lists.empty()) {
+		for (uint32_t id = 0; id < _files.size(); ++id) ids.push_back(id);
+	} else if (lists.front()) {
+		std::sort(lists.begin(), lists.end(),
+			[](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+				return a->size() < b->size();
+			});
+		ids = *lists.front();
+		std::vector<uint32_t> temp;
+		for (size_t i = 1; i < lists.size() && !ids.empty(); ++i) {
+			temp.clear();
+			std::set_intersection(
+				ids.begin(), ids.end(), lists[i]->begin(), lists[i]->end(),
+				std::back_inserter(temp));
+			ids.swap(temp);
+		}
+	}
+	std::vector<std::string> out;
+	for (uint32_t id: ids) {
+		auto &file = _files[id];
+		if (file.live && file.type == Text) out.push_back(file.path);
+	}
+	// Large files were never indexed, so any one of them might match.
+	for (auto &file: _files) {
+		if (file.live && file.type == Large) out.push_back(file.path);
+	}
+	return out;
+}
+
+void Search::Index::compact() {
+	// Renumber the live files and drop the dead ones from the posting lists.
+	if (_dead == 0) return;
+	std::vector<uint32_t> renumber(_files.size(), UINT32_MAX);
+	std::vector<entry> files;
+	for (size_t id = 0; id < _files.size(); ++id) {
+		if (!_files[id].live) continue;
+		renumber[id] = files.size();
+		_ids[_files[id].path] = files.size();
+		files.push_back(std::move(_files[id]));
+	}
+	_files.swap(files);
+	for (auto iter = _postings.begin(); iter != _postings.end();) {
+		auto &list = iter->second;
+		size_t out = 0;
+		for (uint32_t id: list) {
+			if (renumber[id] != UINT32_MAX) list[out++] = renumber[id];
+		}
+		list.resize(out);
+		if (list.empty()) {
+			iter = _postings.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	_dead = 0;
+}
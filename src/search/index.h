@@ -0,0 +1,77 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Search {
+// Find the strings of literal characters which any line matching this basic
+// regular expression must contain.
+std::vector<std::string> literals(const std::string &needle);
+
+// A trigram index records which files in a directory tree contain each
+// sequence of three bytes. A query needs only look at files containing every
+// trigram the needle requires; everything else cannot possibly match. Files
+// are identified by their paths relative to the root, and each is reindexed
+// when its mtime or size changes. The refresh methods may be called from any
+// number of threads at once.
+class Index {
+public:
+	typedef uint32_t trigram;
+	Index(std::string root);
+	// The index lives in the cache directory under a name based on its root.
+	std::string cache_name() const;
+	void load(const std::vector<std::string> &lines);
+	void save(std::vector<std::string> &lines);
+	bool dirty() const { return _dirty; }
+	// Bring the index up to date by visiting every file in the tree. Files
+	// which were not visited by the end of the refresh have been deleted.
+	void begin_refresh();
+	bool current(const std::string &path, const struct stat &st);
+	void update(const std::string &path, const struct stat &st, const char *text, size_t size);
+	void end_refresh();
+	// Which files might contain a line matching this basic regular expression?
+	std::vector<std::string> candidates(const std::string &needle);
+private:
+	enum kind { Text = 'T', Binary = 'B', Large = 'L' };
+	struct entry {
+		std::string path;
+		int64_t mtime;
+		int64_t size;
+		kind type;
+		bool live;
+	};
+	void compact();
+	std::string _root;
+	std::mutex _mutex;
+	std::vector<entry> _files;
+	std::vector<bool> _seen;
+	std::unordered_map<std::string, uint32_t> _ids;
+	std::unordered_map<trigram, std::vector<uint32_t>> _postings;
+	size_t _dead = 0;
+	bool _dirty = false;
+};
+} // namespace Search
+
+#endif //SEARCH_INDEX_H
@@ -0,0 +1,65 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SEARCH_QUEUE_H
+#define SEARCH_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace Search {
+// A lock-free queue which any number of threads may push items into, but
+// from which only one thread may pop them. Pushing is a single atomic
+// exchange, so producers never wait on each other or on the consumer.
+template <typename T>
+class Queue {
+public:
+	Queue(): _head(new Node), _tail(_head.load()) {}
+	Queue(const Queue&) = delete;
+	Queue &operator=(const Queue&) = delete;
+	~Queue() {
+		T item;
+		while (pop(item)) {}
+		delete _tail;
+	}
+	void push(T &&item) {
+		Node *node = new Node;
+		node->item = std::move(item);
+		Node *prev = _head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+	bool pop(T &out) {
+		// The tail is always a node whose item has already been consumed;
+		// the next item waits in the node after it.
+		Node *next = _tail->next.load(std::memory_order_acquire);
+		if (!next) return false;
+		out = std::move(next->item);
+		delete _tail;
+		_tail = next;
+		return true;
+	}
+private:
+	struct Node {
+		std::atomic<Node*> next{nullptr};
+		T item;
+	};
+	std::atomic<Node*> _head;
+	Node *_tail;
+};
+} // namespace Search
+
+#endif //SEARCH_QUEUE_H
@@ -19,9 +19,9 @@
 #include "search/dialog.h"
 #include "app/control.h"
 #include "app/path.h"
+#include "editor/config.h"
 #include <assert.h>
 #include <algorithm>
-#include <unistd.h>
 
 Search::View *Search::View::_instance;
 
@@ -59,28 +59,41 @@ bool Search::View::process(UI::Frame &ctx, int ch) {
 }
 
 bool Search::View::poll(UI::Frame &ctx) {
-	// We only need to poll if we have an active subprocess.
-	if (!_proc.get()) return true;
+	// We only need to poll if we have a search underway.
+	if (!_engine.get()) return true;
 	bool follow_edge = _scrollpos == maxscroll();
-	bool got_bytes = false;
-	ssize_t actual = 0;
-	char buf[1024];
-	// read data from the input in chunks no larger than 1K until there is no
-	// more input to read
-	while ((actual = ::read(_proc->out_fd(), buf, 1024)) > 0) {
-		got_bytes = true;
-		for (ssize_t i = 0; i < actual; ++i) {
-			read_one(buf[i]);
+	// Check for completion first, so we know we have every result once the
+	// engine says it is done.
+	bool done = !_engine->running();
+	std::vector<file> found;
+	bool dirty = _engine->take(found);
+	for (auto &f: found) {
+		line temp = {f.path + ":", f.path, 0};
+		_lines.push_back(temp);
+		_match_files++;
+		for (auto &m: f.matches) {
+			std::string linenumber = std::to_string(m.index + 1) + ":";
+			std::string indent;
+			if (linenumber.size() < 8) {
+				indent.resize(8 - linenumber.size(), ' ');
+			}
+			line temp = {indent + linenumber + m.text, f.path, m.index};
+			_lines.push_back(temp);
+			_match_lines++;
 		}
 	}
-	bool dirty = got_bytes;
 	if (follow_edge && _scrollpos != maxscroll()) {
 		_scrollpos = maxscroll();
 		dirty = true;
 	}
-	if (!_proc->poll()) {
-		_proc.reset(nullptr);
+	if (done) {
+		_engine.reset(nullptr);
 		dirty = true;
+		if (_index && _index->dirty()) {
+			std::vector<std::string> lines;
+			_index->save(lines);
+			ctx.app().cache_write(_index->cache_name(), lines);
+		}
 	}
 	if (dirty) {
 		ctx.repaint();
@@ -90,7 +103,7 @@ bool Search::View::poll(UI::Frame &ctx) {
 }
 
 void Search::View::set_help(UI::HelpBar::Panel &panel) {
-	if (_proc.get()) {
+	if (_engine.get()) {
 		panel.kill();
 	} else {
 		panel.search();
@@ -116,9 +129,18 @@ void Search::View::paint_into(WINDOW *view, State state) {
 		_scrollpos = _selection - std::min(halfpage, _selection);
 	}
 
+	// Only rows which scrolled into view, which show results found since
+	// the last paint, or which gained or lost the selection need drawing.
+	auto dirty = scroll_to(view, state, _scrollpos);
+	size_t fresh = _painted_lines;
+	size_t oldsel = _painted_selection;
+	_painted_lines = _lines.size();
+	_painted_selection = _selection;
 	for (int row = 0; row < _height; ++row) {
-		wmove(view, row, 0);
 		size_t i = row + _scrollpos;
+		bool selchange = i == 1 + oldsel || i == 1 + _selection;
+		if (!dirty[row] && i <= fresh && !selchange) continue;
+		wmove(view, row, 0);
 		// Sub one to create a blank leading line
 		if (i > 0 && i <= _lines.size()) {
 			waddnstr(view, _lines[i-1].text.c_str(), _width);
@@ -130,83 +152,53 @@ void Search::View::paint_into(WINDOW *view, State state) {
 	}
 }
 
-void Search::View::read_one(char ch) {
-	if ('\n' == ch) {
-		// we have just finished processing a line; we should have
-		// between zero and three chunks in our line buffer, which
-		// represent the file path, line number, and match text of
-		// each match returned by grep.
-		_match_lines++;
-		_linebuf.resize(3);
-		std::string file = _linebuf[0];
-		// If this is a new file, add a new match group.
-		if (_lines.empty() || _lines.back().path != file) {
-			line temp = {file + ":", file, 0};
-			_lines.push_back(temp);
-			_match_files++;
-		}
-		std::string linenumber = _linebuf[1] + ":";
-		std::string indent;
-		if (linenumber.size() < 8) {
-			indent.resize(8 - linenumber.size(), ' ');
-		}
-		// Line numbers are printed one-based for human consumption, but the
-		// actual line numbers are of course zero-based. Since we are parsing
-		// the result of some text printed by a tool intended for human use, we
-		// must subtract one to get real line numbers.
-		long index = std::stol(_linebuf[1]) - 1;
-		if (index < 0) index = 0;
-		line temp = {indent + linenumber + _linebuf[2], file, (size_t)index};
-		_lines.push_back(temp);
-		_linebuf.clear();
-	} else if (':' == ch && _linebuf.size() < 3) {
-		// as long as there are fewer than three chunks in the linebuf, add a
-		// new one which will accumulate further characters on this line; we
-		// divide the lines into three fields separated by colons, but the last
-		// field is the match text and may include colons as part of its value.
-		_linebuf.push_back(std::string());
-	} else if (isprint(ch)) {
-		// append the char to the last chunk in the linebuf
-		if (_linebuf.empty()) {
-			_linebuf.push_back(std::string());
-		}
-		_linebuf.back().push_back(ch);
-	}
-}
-
 void Search::View::exec(spec job, UI::Frame &ctx) {
+	// Stop any search in progress before it can touch the index again.
+	_engine.reset(nullptr);
 	_job = job;
 	_match_files = 0;
 	_match_lines = 0;
 	_selection = 0;
 	_scrollpos = 0;
 	_lines.clear();
-	_linebuf.clear();
+	_painted_lines = 0;
+	forget_rows();
+	_error.clear();
 	std::string filter = job.filter.empty()? "*": job.filter;
-	std::string targetfile = "--include=" + filter;
-	std::string targetdir = job.haystack;
-	if (targetdir.empty()) targetdir = ".";
-	const char *argv[6] = {
-		"grep",
-		"-rnHI",
-		targetfile.c_str(),
-		job.needle.c_str(),
-		targetdir.c_str(),
-		nullptr
-	};
 	_title = "find " + job.needle;
 	_title += " in " + filter;
 	if (!job.haystack.empty()) {
 		_title += " under " + Path::display(job.haystack) + "/";
 	}
-	_proc.reset(new Console::Subproc(argv[0], argv));
+	// Trees whose editorconfig settings ask for it get a trigram index,
+	// kept in the cache directory between sessions.
+	std::string root = Path::absolute(job.haystack);
+	Editor::Config config;
+	config.load(root + "/.editorconfig");
+	_index.reset();
+	if (config.search_index()) {
+		auto &index = _indexes[root];
+		if (!index) {
+			index.reset(new Index(root));
+			std::vector<std::string> lines;
+			ctx.app().cache_read(index->cache_name(), lines);
+			index->load(lines);
+		}
+		_index = index;
+	}
+	try {
+		_engine.reset(new Engine(job, _index));
+	} catch (std::exception &e) {
+		_engine.reset(nullptr);
+		_error = e.what();
+	}
 	ctx.repaint();
 	set_title(ctx);
 }
 
 void Search::View::ctl_kill(UI::Frame &ctx) {
-	if (_proc.get()) {
-		_proc.reset(nullptr);
+	if (_engine.get()) {
+		_engine.reset(nullptr);
 		ctx.repaint();
 	}
 }
@@ -249,8 +241,10 @@ void Search::View::key_page_up(UI::Frame &ctx) {
 void Search::View::set_title(UI::Frame &ctx) {
 	ctx.set_title(_title);
 	std::string status;
-	if (_proc.get()) {
+	if (_engine.get()) {
 		status = "running";
+	} else if (!_error.empty()) {
+		status = _error;
 	} else {
 		status = std::to_string(_match_lines) + " matches in ";
 		status += std::to_string(_match_files) + " files";
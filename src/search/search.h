@@ -21,8 +21,8 @@
 #include "ui/view.h"
 #include "ui/shell.h"
 #include "dialog/form.h"
-#include "console/subproc.h"
 #include "search/engine.h"
+#include <map>
 #include <set>
 
 namespace Search {
@@ -42,7 +42,6 @@ protected:
 	UI::Window *_window = nullptr;
 	virtual void paint_into(WINDOW *view, State state) override;
 private:
-	void read_one(char ch);
 	void exec(spec job, UI::Frame &ctx);
 	void ctl_kill(UI::Frame &ctx);
 	void search(UI::Frame &ctx);
@@ -63,13 +62,18 @@ private:
 	std::vector<line> _lines;
 	unsigned _match_lines = 0;
 	unsigned _match_files = 0;
-	// connection to the shell running find and grep
-	std::unique_ptr<Console::Subproc> _proc;
-	// linebuf is temporary storage used while reading data from _proc
-	std::vector<std::string> _linebuf;
+	// the search in progress, if any
+	std::unique_ptr<Engine> _engine;
+	// trigram indexes for trees which ask for them, by absolute path
+	std::map<std::string, std::shared_ptr<Index>> _indexes;
+	std::shared_ptr<Index> _index;
+	std::string _error;
 	std::string _title;
 	unsigned _scrollpos = 0;
 	size_t _selection = 0;
+	// What was on screen when the view was last painted?
+	size_t _painted_lines = 0;
+	size_t _painted_selection = 0;
 	int _height = 0;
 	int _width = 0;
 };
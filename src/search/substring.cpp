@@ -0,0 +1,55 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "search/substring.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// We compare the first and last bytes of the needle against sixteen positions
+// at once, and only check the whole needle where both match.
+const char *Search::substring(
+		const char *begin, const char *end, const std::string &needle) {
+	size_t len = needle.size();
+	if ((size_t)(end - begin) < len) return nullptr;
+	const char *last = end - len;
+	const char *pos = begin;
+#ifdef __SSE2__
+	const __m128i first = _mm_set1_epi8(needle.front());
+	const __m128i final = _mm_set1_epi8(needle.back());
+	for (; pos + 16 <= last + 1; pos += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)pos);
+		__m128i b = _mm_loadu_si128((const __m128i*)(pos + len - 1));
+		__m128i eq = _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, final));
+		unsigned mask = _mm_movemask_epi8(eq);
+		while (mask) {
+			unsigned bit = __builtin_ctz(mask);
+			if (0 == memcmp(pos + bit + 1, needle.data() + 1, len - 1)) {
+				return pos + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; pos <= last; ++pos) {
+		pos = (const char*)memchr(pos, needle.front(), last + 1 - pos);
+		if (!pos) return nullptr;
+		if (0 == memcmp(pos + 1, needle.data() + 1, len - 1)) return pos;
+	}
+	return nullptr;
+}
@@ -31,6 +31,9 @@ UI::Shell::Shell(Controller &app): _app(app) {
 	initscr();
 	// We want color, if available.
 	Colors::init();
+	// Normally curses sends each frame to the screen, but we may do that
+	// ourselves instead.
+	if (Terminal::enabled()) _terminal.reset(new Terminal);
 	// Don't automatically echo characters back to the screen; we will draw
 	// things ourselves when we want them to appear.
 	noecho();
@@ -48,21 +51,25 @@ UI::Shell::Shell(Controller &app): _app(app) {
 	// don't flush the output buffer when the user presses  one of the
 	// traditional interrupt keys, since we have different purposes for them.
 	intrflush(stdscr, FALSE);
-	// Enable the function keys, so the user can navigate using the arrow keys.
-	keypad(stdscr, true);
 	// By default, don't show the cursor; editors will reveal it when active if
 	// they choose.
 	curs_set(0);
-	// Reduce the escape delay, since nobody is going to use this on an old
-	// serial line, and it's much more useful to be able to cancel things with
-	// the escape key than to use it to type control characters.
-	set_escdelay(25);
+	// We decode the keyboard ourselves, rather than letting curses do it, so
+	// ask the terminal to be as clear as it can be: bracket pasted text, so
+	// we can insert it all at once, and report keys unambiguously, so the
+	// escape key needs no delay, if the terminal knows how.
+	putp("\033[?2004h");
+	putp("\033[>1u");
+	fflush(stdout);
 }
 
 UI::Shell::~Shell() {
 	// Delete all of the windows.
 	_tabs.clear();
-	// Clean up ncurses.
+	// Clean up ncurses, and put the terminal back the way it was.
+	putp("\033[<u");
+	putp("\033[?2004l");
+	fflush(stdout);
 	endwin();
 }
 
@@ -85,12 +92,39 @@ bool UI::Shell::process(int ch) {
 	return !_tabs.empty();
 }
 
+bool UI::Shell::paste(const std::string &text) {
+	if (!_tabs[_focus]->paste(text)) {
+		close_window(_focus);
+		layout();
+	}
+	reap();
+	return !_tabs.empty();
+}
+
+void UI::Shell::update() {
+	update_panels();
+	if (_terminal) {
+		_terminal->update();
+	} else {
+		doupdate();
+	}
+}
+
 void UI::Shell::poll() {
 	for (size_t index = _tabs.size(); index > 0; --index) {
 		_tabs[index - 1]->poll();
 	}
 }
 
+bool UI::Shell::take_painted() {
+	bool out = _painted;
+	_painted = false;
+	for (auto &tab: _tabs) {
+		out |= tab->take_painted();
+	}
+	return out;
+}
+
 void UI::Shell::key_left() {
 	if (_focus > 0) {
 		set_focus(_focus - 1);
@@ -242,6 +276,7 @@ void UI::Shell::close_window(size_t index) {
 	// one of its methods might be on our call stack.
 	_doomed.emplace(std::move(_tabs[index]));
 	_tabs.erase(_tabs.begin() + index);
+	_painted = true;
 	// If the current focus window's index is greater than the index we just
 	// deleted, change the index to its new, correct value.
 	if (index < _focus) {
@@ -18,6 +18,7 @@
 #ifndef UI_SHELL_H
 #define UI_SHELL_H
 
+#include "ui/terminal.h"
 #include "ui/window.h"
 #include <vector>
 #include <queue>
@@ -28,7 +29,12 @@ public:
 	Shell(Controller &app);
 	~Shell();
 	bool process(int ch);
+	bool paste(const std::string &text);
 	void poll();
+	// Has anything changed on screen since the last time we asked?
+	bool take_painted();
+	// Send everything the windows have drawn to the screen.
+	void update();
 	Window *open_window(std::unique_ptr<View> &&view);
 	void close_window(Window *window);
 	void make_active(Window *window);
@@ -57,6 +63,8 @@ private:
 	int _columnWidth = 0;
 	size_t _focus = 0;
 	std::queue<std::unique_ptr<Window>> _doomed;
+	bool _painted = true;
+	std::unique_ptr<Terminal> _terminal;
 };
 } // namespace UI
 
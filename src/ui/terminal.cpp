@@ -0,0 +1,378 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "ui/terminal.h"
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+
+namespace {
+// Attributes which change how a cell looks, as opposed to what it shows.
+const attr_t kStyle = A_BOLD | A_DIM | A_UNDERLINE | A_BLINK | A_REVERSE | A_STANDOUT;
+// A gap this narrow between changed cells costs less to draw over again
+// than to move across.
+const int kMaxSkip = 4;
+// A run of blanks this long costs less to erase than to draw.
+const int kMinErase = 8;
+// A frame this small goes out in a single write, which the terminal will
+// not split; bracketing it would only add to its size.
+const size_t kMinSync = 128;
+
+struct glyph_t {
+	wchar_t text[CCHARW_MAX + 1];
+	attr_t attr;
+	short pair;
+	int width;
+};
+
+glyph_t unpack(const cchar_t &cell) {
+	glyph_t out;
+	getcchar(&cell, out.text, &out.attr, &out.pair, nullptr);
+	out.width = (wcwidth(out.text[0]) > 1)? 2: 1;
+	return out;
+}
+
+bool blank(const cchar_t &cell) {
+	glyph_t g = unpack(cell);
+	return g.text[0] == L' ' && g.text[1] == 0 && !(g.attr & kStyle) && !g.pair;
+}
+
+bool same(const cchar_t &a, const cchar_t &b) {
+	return 0 == memcmp(&a, &b, sizeof(cchar_t));
+}
+
+size_t hash(const cchar_t *row, int cols) {
+	// FNV-1a, over the bytes of the cells
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(row);
+	size_t out = 2166136261u;
+	for (size_t i = 0; i < cols * sizeof(cchar_t); ++i) {
+		out = (out ^ bytes[i]) * 16777619u;
+	}
+	return out;
+}
+
+// Curses keeps its line-drawing characters in the terminal's alternate
+// character set; we send their Unicode equivalents instead.
+wchar_t acs(wchar_t ch) {
+	switch (ch) {
+		case 'j': return L'┘';
+		case 'k': return L'┐';
+		case 'l': return L'┌';
+		case 'm': return L'└';
+		case 'n': return L'┼';
+		case 'q': return L'─';
+		case 't': return L'├';
+		case 'u': return L'┤';
+		case 'v': return L'┴';
+		case 'w': return L'┬';
+		case 'x': return L'│';
+		case '~': return L'·';
+		case 'a': return L'▒';
+		case '`': return L'◆';
+		case '0': return L'█';
+		default: return ch;
+	}
+}
+
+void color(std::string &out, short index, int base) {
+	// Negative means the terminal's default, which a reset has restored.
+	if (index < 0) return;
+	if (index < 8) {
+		out += ";" + std::to_string(base + index);
+	} else if (index < 16) {
+		out += ";" + std::to_string(base + 60 + index - 8);
+	} else {
+		out += ";" + std::to_string(base + 8) + ";5;" + std::to_string(index);
+	}
+}
+} // namespace
+
+bool UI::Terminal::enabled() {
+	const char *renderer = getenv("OZETTE_RENDERER");
+	return renderer && !strcmp(renderer, "vt");
+}
+
+void UI::Terminal::update() {
+	_out.clear();
+	if (LINES != _rows || COLS != _cols) {
+		reset(LINES, COLS);
+	}
+	// Reading the virtual screen moves its cursor, but that is where the
+	// terminal's cursor belongs once we are done, so put it back afterward.
+	int cursor_row, cursor_col;
+	getyx(newscr, cursor_row, cursor_col);
+	// Blank cells all look alike, however curses happened to fill them in.
+	for (int row = 0; row < _rows; ++row) {
+		cchar_t *back = &_back[row * _cols];
+		for (int col = 0; col < _cols; ++col) {
+			mvwin_wch(newscr, row, col, &back[col]);
+			if (blank(back[col])) back[col] = _space;
+		}
+		_back_hash[row] = hash(back, _cols);
+	}
+	wmove(newscr, cursor_row, cursor_col);
+	scroll_region();
+	for (int row = 0; row < _rows; ++row) {
+		cchar_t *back = &_back[row * _cols];
+		cchar_t *front = &_front[row * _cols];
+		// Past the last visible character, the row is blank, and a single
+		// erase-to-end-of-line will clear whatever remains there.
+		int tail = _cols;
+		while (tail > 0 && blank(back[tail - 1])) tail--;
+		int col = 0;
+		while (col < _cols) {
+			if (col >= tail && !same(back[col], front[col])) {
+				move_to(row, col);
+				set_style(A_NORMAL, 0);
+				_out += "\033[K";
+				std::copy(back + col, back + _cols, front + col);
+				break;
+			}
+			if (!same(back[col], front[col]) && same(back[col], _space)) {
+				int run = 1;
+				while (col + run < tail && same(back[col + run], _space)) run++;
+				if (run >= kMinErase) {
+					move_to(row, col);
+					set_style(A_NORMAL, 0);
+					_out += "\033[" + std::to_string(run) + "X";
+					std::copy(back + col, back + col + run, front + col);
+					col += run;
+					continue;
+				}
+			}
+			// A wide character covers the next cell too, so skip over it.
+			int width = unpack(back[col]).width;
+			if (!same(back[col], front[col])) {
+				move_to(row, col);
+				put(back[col]);
+			}
+			std::copy(back + col, back + std::min(col + width, _cols), front + col);
+			col += width;
+		}
+		_front_hash[row] = _back_hash[row];
+	}
+	if (_out.empty()) return;
+	if (!is_leaveok(newscr)) {
+		move_to(cursor_row, cursor_col);
+	}
+	flush();
+}
+
+void UI::Terminal::reset(int rows, int cols) {
+	// We no longer know what the screen shows, so clear it and start over.
+	_rows = rows;
+	_cols = cols;
+	setcchar(&_space, L" ", A_NORMAL, 0, nullptr);
+	_front.assign(rows * cols, _space);
+	_back.resize(rows * cols);
+	_blank_hash = hash(&_front[0], cols);
+	_front_hash.assign(rows, _blank_hash);
+	_back_hash.resize(rows);
+	_out += "\033[0m\033[H\033[2J";
+	_attr = A_NORMAL;
+	_pair = 0;
+	_row = 0;
+	_col = 0;
+}
+
+void UI::Terminal::scroll_region() {
+	// When a view scrolls, most of what the screen already shows is still
+	// good, only in different rows. Find the shift which would fix the most
+	// rows, and if it is worth doing, let the terminal move them for us.
+	int best_shift = 0;
+	int best_score = 1;
+	int best_top = 0;
+	int best_bottom = 0;
+	for (int shift = 1 - _rows; shift < _rows; ++shift) {
+		if (0 == shift) continue;
+		// The longest run of rows which the shift would put in place.
+		int top = std::max(0, -shift);
+		int end = std::min(_rows, _rows - shift);
+		for (int row = top; row < end;) {
+			if (!same_row(row, row + shift)) {
+				row++;
+				continue;
+			}
+			int first = row;
+			int score = 0;
+			while (row < end && same_row(row, row + shift)) {
+				if (_back_hash[row] != _front_hash[row]) score++;
+				row++;
+			}
+			// The rows the shift exposes will have to be drawn again.
+			int exposed = (shift > 0)? row: first + shift;
+			for (int i = exposed; i < exposed + abs(shift); ++i) {
+				if (same_row(i, i) && _back_hash[i] != _blank_hash) score--;
+			}
+			if (score > best_score) {
+				best_score = score;
+				best_shift = shift;
+				best_top = std::min(first, first + shift);
+				best_bottom = std::max(row, row + shift);
+			}
+		}
+	}
+	if (0 == best_shift) return;
+	// Scroll only the region holding the rows which move, clearing what it
+	// exposes to the default background.
+	set_style(A_NORMAL, 0);
+	_out += "\033[" + std::to_string(best_top + 1) + ";";
+	_out += std::to_string(best_bottom) + "r";
+	_out += "\033[" + std::to_string(abs(best_shift));
+	_out += (best_shift > 0)? "S": "T";
+	_out += "\033[r";
+	_row = 0;
+	_col = 0;
+	int count = best_bottom - best_top;
+	int moved = count - abs(best_shift);
+	cchar_t *region = &_front[best_top * _cols];
+	size_t *hashes = &_front_hash[best_top];
+	if (best_shift > 0) {
+		size_t offset = best_shift * _cols;
+		std::copy(region + offset, region + count * _cols, region);
+		std::fill(region + moved * _cols, region + count * _cols, _space);
+		std::copy(hashes + best_shift, hashes + count, hashes);
+		std::fill(hashes + moved, hashes + count, _blank_hash);
+	} else {
+		size_t offset = -best_shift * _cols;
+		std::copy_backward(region, region + moved * _cols, region + count * _cols);
+		std::fill(region, region + offset, _space);
+		std::copy_backward(hashes, hashes + moved, hashes + count);
+		std::fill(hashes, hashes - best_shift, _blank_hash);
+	}
+}
+
+bool UI::Terminal::same_row(int back, int front) const {
+	if (_back_hash[back] != _front_hash[front]) return false;
+	const cchar_t *b = &_back[back * _cols];
+	const cchar_t *f = &_front[front * _cols];
+	return 0 == memcmp(b, f, _cols * sizeof(cchar_t));
+}
+
+void UI::Terminal::move_to(int row, int col) {
+	if (row == _row && col == _col) return;
+	bool known = _row >= 0 && _col >= 0;
+	if (known && row == _row && col > _col) {
+		if (col - _col <= kMaxSkip && skip_to(row, col)) return;
+		_out += "\033[" + std::to_string(col - _col) + "C";
+	} else if (_row >= 0 && col == 0 && (row == _row || row == _row + 1)) {
+		_out += (row == _row)? "\r": "\r\n";
+	} else if (col == 0) {
+		_out += "\033[" + std::to_string(row + 1) + "H";
+	} else {
+		_out += "\033[" + std::to_string(row + 1) + ";";
+		_out += std::to_string(col + 1) + "H";
+	}
+	_row = row;
+	_col = col;
+}
+
+bool UI::Terminal::skip_to(int row, int col) {
+	// Draw the cells in between over again, if that is possible without
+	// changing attributes.
+	const cchar_t *front = &_front[row * _cols];
+	// A blank looks the same in any style which leaves the background alone.
+	short fg = -1, bg = -1;
+	if (_pair) pair_content(_pair, &fg, &bg);
+	bool plain = bg < 0 && !(_attr & (A_REVERSE | A_STANDOUT | A_UNDERLINE));
+	for (int i = _col; i < col; ++i) {
+		if (plain && same(front[i], _space)) continue;
+		glyph_t g = unpack(front[i]);
+		if (g.width != 1 || (g.attr & kStyle) != _attr || g.pair != _pair) {
+			return false;
+		}
+	}
+	for (int i = _col; i < col; ++i) {
+		if (same(front[i], _space)) {
+			_out.push_back(' ');
+			_col++;
+		} else {
+			put(front[i]);
+		}
+	}
+	return true;
+}
+
+void UI::Terminal::set_style(attr_t attr, short pair) {
+	if (attr == _attr && pair == _pair) return;
+	_out += "\033[0";
+	if (attr & A_BOLD) _out += ";1";
+	if (attr & A_DIM) _out += ";2";
+	if (attr & A_UNDERLINE) _out += ";4";
+	if (attr & A_BLINK) _out += ";5";
+	if (attr & (A_REVERSE | A_STANDOUT)) _out += ";7";
+	if (pair) {
+		short fg, bg;
+		if (OK == pair_content(pair, &fg, &bg)) {
+			color(_out, fg, 30);
+			color(_out, bg, 40);
+		}
+	}
+	_out += "m";
+	_attr = attr;
+	_pair = pair;
+}
+
+void UI::Terminal::put(const cchar_t &cell) {
+	glyph_t g = unpack(cell);
+	set_style(g.attr & kStyle, g.pair);
+	if (!g.text[0]) {
+		g.text[0] = L' ';
+		g.text[1] = 0;
+	}
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+	for (wchar_t *ch = g.text; *ch; ++ch) {
+		wchar_t c = (g.attr & A_ALTCHARSET)? acs(*ch): *ch;
+		char buf[MB_LEN_MAX];
+		size_t len = wcrtomb(buf, c, &state);
+		if (len == (size_t)-1) {
+			_out.push_back('?');
+			memset(&state, 0, sizeof(state));
+		} else {
+			_out.append(buf, len);
+		}
+	}
+	// Once the last column has been drawn, terminals disagree about where
+	// the cursor is.
+	_col += g.width;
+	if (_col >= _cols) _col = -1;
+}
+
+void UI::Terminal::flush() {
+	// Bracket the frame, so terminals which understand synchronized output
+	// will show all of it at once.
+	std::string frame = _out;
+	if (frame.size() >= kMinSync) {
+		frame = "\033[?2026h" + frame + "\033[?2026l";
+	}
+	const char *buf = frame.data();
+	size_t len = frame.size();
+	while (len) {
+		ssize_t done = write(STDOUT_FILENO, buf, len);
+		if (done < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		buf += done;
+		len -= done;
+	}
+}
@@ -0,0 +1,65 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef UI_TERMINAL_H
+#define UI_TERMINAL_H
+
+#include <ncurses.h>
+#include <string>
+#include <vector>
+
+namespace UI {
+// The terminal writes finished frames straight to the screen, instead of
+// leaving it to doupdate(). Windows and panels still compose the frame in
+// curses' virtual screen; the terminal compares that with what it last
+// sent and emits the shortest sequence of cursor motions, attribute
+// changes, and text it can find, bracketed as a synchronized update so the
+// screen never shows half a frame. Set OZETTE_RENDERER=vt to use it.
+class Terminal {
+public:
+	static bool enabled();
+	// Send everything which has changed in the virtual screen.
+	void update();
+private:
+	void reset(int rows, int cols);
+	void scroll_region();
+	bool same_row(int back, int front) const;
+	void move_to(int row, int col);
+	bool skip_to(int row, int col);
+	void set_style(attr_t attr, short pair);
+	void put(const cchar_t &cell);
+	void flush();
+	int _rows = 0;
+	int _cols = 0;
+	// What the screen shows now, and what it should show next.
+	std::vector<cchar_t> _front;
+	std::vector<cchar_t> _back;
+	std::vector<size_t> _front_hash;
+	std::vector<size_t> _back_hash;
+	cchar_t _space;
+	size_t _blank_hash = 0;
+	// Where the terminal's cursor is, or -1 if we aren't sure, and which
+	// attributes it is drawing with.
+	int _row = -1;
+	int _col = -1;
+	attr_t _attr = A_NORMAL;
+	short _pair = 0;
+	std::string _out;
+};
+} // namespace UI
+
+#endif // UI_TERMINAL_H
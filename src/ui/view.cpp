@@ -17,8 +17,13 @@
 
 #include "ui/view.h"
 #include "ui/colors.h"
+#include <algorithm>
+#include <cstdlib>
 
-UI::View::View(): _window(newwin(0, 0, 0, 0)), _panel(new_panel(_window)) {}
+UI::View::View(): _window(newwin(0, 0, 0, 0)), _panel(new_panel(_window)) {
+	// Let curses scroll the terminal instead of redrawing moved lines.
+	idlok(_window, TRUE);
+}
 
 UI::View::~View() {
 	del_panel(_panel);
@@ -32,6 +37,7 @@ void UI::View::layout(int vpos, int hpos, int height, int width) {
 	getbegyx(_window, old_vpos, old_hpos);
 	if (old_height != height || old_width != width) {
 		WINDOW *replacement = newwin(height, width, vpos, hpos);
+		idlok(replacement, TRUE);
 		replace_panel(_panel, replacement);
 		delwin(_window);
 		_window = replacement;
@@ -49,6 +55,7 @@ void UI::View::paint(State state) {
 	curs_set(0);
 	wattrset(_window, Colors::content(state != State::Inactive));
 	paint_into(_window, state);
+	_overlaid = false;
 	wstandend(_window);
 }
 
@@ -73,5 +80,44 @@ void UI::View::overlay_result(std::string message, State state) {
 	waddstr(_window, " ]");
 	wattroff(_window, color);
 	wmove(_window, cury, curx);
+	_overlaid = true;
+}
+
+void UI::View::scroll_rows(WINDOW *view, int lines) {
+	// The window must not scroll when something is drawn in its last cell,
+	// so it is only allowed to scroll for the moment it takes to do so.
+	scrollok(view, TRUE);
+	wscrl(view, lines);
+	scrollok(view, FALSE);
+}
+
+std::vector<bool> UI::View::scroll_to(WINDOW *view, State state, size_t pos) {
+	int height, width;
+	getmaxyx(view, height, width);
+	bool keep = _rows_valid && state == _rows_state &&
+			height == _rows_height && width == _rows_width;
+	std::vector<bool> dirty(height, !keep);
+	long delta = keep? (long)pos - (long)_rows_pos: 0;
+	if (labs(delta) >= height) {
+		dirty.assign(height, true);
+	} else if (delta != 0) {
+		scroll_rows(view, (int)delta);
+		if (delta > 0) {
+			std::fill(dirty.end() - delta, dirty.end(), true);
+		} else {
+			std::fill(dirty.begin(), dirty.begin() - delta, true);
+		}
+	}
+	// The row under a result message has moved along with the others.
+	long overlay = height - 1 - delta;
+	if (_overlaid && overlay >= 0 && overlay < height) {
+		dirty[overlay] = true;
+	}
+	_rows_valid = true;
+	_rows_pos = pos;
+	_rows_state = state;
+	_rows_height = height;
+	_rows_width = width;
+	return dirty;
 }
 
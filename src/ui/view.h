@@ -20,6 +20,7 @@
 
 #include <ncurses.h>
 #include <panel.h>
+#include <vector>
 #include "ui/frame.h"
 #include "ui/helpbar.h"
 
@@ -41,6 +42,9 @@ public:
 	virtual void activate(Frame &ctx) {}
 	virtual void deactivate(Frame &ctx) {}
 	virtual bool process(Frame &ctx, int ch) = 0;
+	// Text the user pasted into the terminal. A view which does not take the
+	// whole text at once returns false and receives it as keystrokes.
+	virtual bool paste(Frame &ctx, const std::string &text) { return false; }
 	virtual bool poll(Frame &ctx) { return true; }
 	virtual void set_help(HelpBar::Panel &panel) {}
 	enum class Priority {
@@ -51,9 +55,27 @@ public:
 	virtual Priority priority() const { return Priority::Any; }
 protected:
 	virtual void paint_into(WINDOW *view, State state) = 0;
+	// Shift the rows already drawn up by some number of lines, or down if
+	// negative, leaving blank rows where new content scrolls into view.
+	static void scroll_rows(WINDOW *view, int lines);
+	// For views which show a scrolling list of rows: move the rows drawn by
+	// the last paint to follow the new scroll position, and report which
+	// rows must be painted again. After a change of size or state, or after
+	// forget_rows(), that is all of them.
+	std::vector<bool> scroll_to(WINDOW *view, State state, size_t pos);
+	void forget_rows() { _rows_valid = false; }
+	// Is a result message drawn over the bottom row of the view?
+	bool overlaid() const { return _overlaid; }
 private:
 	WINDOW *_window = nullptr;
 	PANEL *_panel = nullptr;
+	bool _overlaid = false;
+	// Scroll position, state, and size as of the last scroll_to()
+	bool _rows_valid = false;
+	size_t _rows_pos = 0;
+	State _rows_state = State::Inactive;
+	int _rows_height = 0;
+	int _rows_width = 0;
 };
 } // namespace UI
 
@@ -18,6 +18,7 @@
 #include "ui/shell.h"
 #include "app/control.h"
 #include "ui/colors.h"
+#include "unicode/unicode.h"
 #include <algorithm>
 #include <assert.h>
 #include <cstring>
@@ -80,6 +81,7 @@ void UI::Window::layout(int xpos, int width) {
 	}
 	layout_contentwin();
 	_dirty_chrome = true;
+	_dirty_frame = true;
 	paint();
 }
 
@@ -87,6 +89,7 @@ void UI::Window::set_focus() {
 	_view->activate(*this);
 	_has_focus = true;
 	_dirty_chrome = true;
+	_dirty_frame = true;
 	_dirty_content = true;
 	if (_dialog) _dialog->activate(*this);
 	paint();
@@ -97,6 +100,7 @@ void UI::Window::clear_focus() {
 	clear_result();
 	_has_focus = false;
 	_dirty_chrome = true;
+	_dirty_frame = true;
 	_dirty_content = true;
 	if (_dialog) _dialog->deactivate(*this);
 	paint();
@@ -132,6 +136,22 @@ bool UI::Window::process(int ch) {
 	return more;
 }
 
+bool UI::Window::paste(const std::string &text) {
+	clear_result();
+	View *target = _dialog? _dialog.get(): _view.get();
+	if (target->paste(*this, text)) {
+		paint();
+		return true;
+	}
+	// Deliver the text as if it had been typed, which is what the terminal
+	// would have sent us without bracketed paste.
+	for (char ch: text) {
+		int key = ('\n' == ch)? Control::Return: (unsigned char)ch;
+		if (!process(key)) return false;
+	}
+	return true;
+}
+
 bool UI::Window::poll() {
 	bool more = true;
 	if (_dialog) {
@@ -141,6 +161,8 @@ bool UI::Window::poll() {
 			_dialog = std::move(temp);
 		} else {
 			_view->activate(*this);
+			_dirty_chrome = true;
+			_dirty_frame = true;
 		}
 	} else {
 		more = _view->poll(*this);
@@ -162,6 +184,7 @@ void UI::Window::set_status(std::string text) {
 void UI::Window::show_dialog(std::unique_ptr<View> &&host) {
 	clear_result();
 	_dirty_chrome = true;
+	_dirty_frame = true;
 	_dialog = std::move(host);
 	int vpos, hpos, height, width;
 	calculate_content(vpos, hpos, height, width);
@@ -224,11 +247,19 @@ void UI::Window::layout_helpbar() {
 	if (new_height != _helpbar_height) {
 		_helpbar_height = new_height;
 		_dirty_chrome = true;
+		_dirty_frame = true;
 		layout_contentwin();
 	}
 }
 
+bool UI::Window::take_painted() {
+	bool out = _painted;
+	_painted = false;
+	return out;
+}
+
 void UI::Window::paint() {
+	_painted |= _dirty_content || _dirty_chrome;
 	if (_dirty_content) paint_content();
 	if (_dirty_chrome) paint_chrome();
 }
@@ -258,34 +289,39 @@ void UI::Window::paint_content() {
 }
 
 void UI::Window::paint_chrome() {
-	wattrset(_framewin, Colors::chrome(_has_focus && !_dialog));
 	int height, width;
 	getmaxyx(_framewin, height, width);
-	paint_titlebar(width);
-	if (_lframe) {
-		mvwvline(_framewin, 1, 0, ACS_VLINE, height - 1);
-	}
-	if (_rframe) {
-		mvwvline(_framewin, 1, width-1, ACS_VLINE, height-1);
+	// The frame only changes with the window's layout, focus, or dialog;
+	// whenever it does, forget what the rest of the chrome looked like.
+	if (_dirty_frame) {
+		_drawn.clear();
+		wattrset(_framewin, Colors::chrome(_has_focus && !_dialog));
+		if (_lframe) {
+			mvwvline(_framewin, 1, 0, ACS_VLINE, height - 1);
+		}
+		if (_rframe) {
+			mvwvline(_framewin, 1, width-1, ACS_VLINE, height-1);
+		}
+		wstandend(_framewin);
+		_dirty_frame = false;
 	}
+	_drawn.resize(1 + _helpbar_height);
+	paint_titlebar(width);
 	if (_helpbar_height) {
-		// The task bar is still active when a dialog is open, because it shows
-		// context-specific information.
-		wattrset(_framewin, Colors::chrome(_has_focus));
 		paint_helpbar(height, width);
 	}
 	_dirty_chrome = false;
-	wstandend(_framewin);
 }
 
 void UI::Window::paint_titlebar(int width) {
 	// Draw corners and a horizontal line across the top.
-	mvwhline(_framewin, 0, 0, ACS_HLINE, width);
+	int chrome = Colors::chrome(_has_focus && !_dialog);
+	std::vector<cchar_t> row(width, cell(WACS_HLINE, chrome));
 	if (_lframe) {
-		mvwaddch(_framewin, 0, 0, ACS_ULCORNER);
+		row.front() = cell(WACS_ULCORNER, chrome);
 	}
 	if (_rframe) {
-		mvwaddch(_framewin, 0, width-1, ACS_URCORNER);
+		row.back() = cell(WACS_URCORNER, chrome);
 	}
 	std::string left_text = _swap_titlebar? _status: _title;
 	std::string right_text = _swap_titlebar? _title: _status;
@@ -308,20 +344,17 @@ void UI::Window::paint_titlebar(int width) {
 		}
 	}
 	if (!left_text.empty()) {
-		wmove(_framewin, 0, left);
 		bool highlight = _has_focus && !_dialog.get();
-		if (highlight) wattron(_framewin, A_REVERSE);
-		waddch(_framewin, ' ');
-		waddnstr(_framewin, left_text.c_str(), titlechars);
-		waddch(_framewin, ' ');
-		if (highlight) wattroff(_framewin, A_REVERSE);
+		int style = chrome | (highlight? A_REVERSE: 0);
+		std::string text = " " + left_text.substr(0, titlechars) + " ";
+		put_text(row, left, text, titlechars + 2, style);
 	}
 	if (!right_text.empty()) {
 		int chars = std::min((int)right_text.size(), titlechars);
-		mvwaddch(_framewin, 0, right - chars - 2, ' ');
-		waddnstr(_framewin, right_text.c_str(), chars);
-		waddch(_framewin, ' ');
+		std::string text = " " + right_text.substr(0, chars) + " ";
+		put_text(row, right - chars - 2, text, chars + 2, chrome);
 	}
+	paint_row(0, 0, row, _drawn[0]);
 }
 
 void UI::Window::paint_helpbar(int height, int width) {
@@ -343,36 +376,73 @@ void UI::Window::paint_helpbar(int height, int width) {
 	width -= xpos;
 	if (_rframe) width--;
 	int ypos = height - _helpbar_height;
-	// Clear out the space we're going to work in.
-	for (int v = ypos; v < height; ++v) {
-		mvwhline(_framewin, v, xpos, ' ', width);
-	}
 
-	// Render the help panel for this window.
+	// Render the help panel for this window a row at a time. The task bar is
+	// still active when a dialog is open, because it shows context-specific
+	// information.
+	int chrome = Colors::chrome(_has_focus);
 	int labelwidth = width / HelpBar::Panel::kWidth;
 	int textwidth = labelwidth - 4;
-	unsigned v = 0;
-	unsigned h = 0;
-
 	int key_highlight = _has_focus ? A_REVERSE : 0;
-	int cells = HelpBar::Panel::kWidth * HelpBar::Panel::kHeight;
-	for (int i = 0; i < cells; ++i) {
-		v = i / HelpBar::Panel::kWidth;
-		h = i % HelpBar::Panel::kWidth;
-		auto &label = panel.label[v][h];
-		if (0 == label.mnemonic[0]) continue;
-		unsigned labelpos = h * labelwidth;
-		wmove(_framewin, v+ypos, labelpos+xpos);
-		wattron(_framewin, key_highlight);
-		waddch(_framewin, label.mnemonic[0]);
-		waddch(_framewin, label.mnemonic[1]);
-		wattroff(_framewin, key_highlight);
-		waddch(_framewin, ' ');
-		waddnstr(_framewin, label.text.c_str(), textwidth);
-		waddch(_framewin, ' ');
+	for (unsigned v = 0; v < _helpbar_height; ++v) {
+		std::vector<cchar_t> row(width, cell(L' ', chrome));
+		for (unsigned h = 0; h < HelpBar::Panel::kWidth; ++h) {
+			auto &label = panel.label[v][h];
+			if (0 == label.mnemonic[0]) continue;
+			int labelpos = h * labelwidth;
+			std::string key(label.mnemonic, 2);
+			put_text(row, labelpos, key, 2, chrome | key_highlight);
+			put_text(row, labelpos + 2, " " + label.text, textwidth + 1, chrome);
+		}
+		paint_row(ypos + v, xpos, row, _drawn[1 + v]);
 	}
 }
 
+cchar_t UI::Window::cell(wchar_t ch, int style) {
+	cchar_t out;
+	memset(&out, 0, sizeof(out));
+	wchar_t text[2] = {ch, 0};
+	attr_t attrs = style & ~A_COLOR;
+	setcchar(&out, text, attrs, PAIR_NUMBER(style), nullptr);
+	return out;
+}
+
+cchar_t UI::Window::cell(const cchar_t *acs, int style) {
+	wchar_t text[CCHARW_MAX + 1];
+	attr_t attrs;
+	short pair;
+	getcchar(acs, text, &attrs, &pair, nullptr);
+	return cell(text[0], style | attrs);
+}
+
+void UI::Window::put_text(
+		std::vector<cchar_t> &row,
+		int pos,
+		const std::string &text,
+		int limit,
+		int style) {
+	// Decode the text, one character per cell, until it runs out or it
+	// reaches the limit or the end of the row.
+	size_t i = 0;
+	for (int n = 0; i < text.size() && n < limit; ++n, ++pos) {
+		wchar_t ch = Unicode::decode(text.data(), text.size(), i);
+		if (pos < 0) continue;
+		if (pos >= (int)row.size()) break;
+		row[pos] = cell(ch, style);
+	}
+}
+
+void UI::Window::paint_row(
+		int v, int h, std::vector<cchar_t> &row, std::vector<cchar_t> &drawn) {
+	// Touch only the cells which differ from what was drawn last time.
+	bool all = drawn.size() != row.size();
+	for (size_t i = 0; i < row.size(); ++i) {
+		if (!all && 0 == memcmp(&row[i], &drawn[i], sizeof(cchar_t))) continue;
+		mvwadd_wch(_framewin, v, h + i, &row[i]);
+	}
+	drawn.swap(row);
+}
+
 std::string UI::Window::ltrunc(const std::string &text, size_t surplus) {
 	return (text.size() > surplus)? text.substr(surplus): "";
 }
@@ -395,6 +465,8 @@ void UI::Window::process_dialog(int ch) {
 		// doing.
 		_view->activate(*this);
 		_dirty_content = true;
+		_dirty_chrome = true;
+		_dirty_frame = true;
 	}
 }
 
@@ -402,4 +474,6 @@ void UI::Window::close_dialog() {
 	_dialog.reset(nullptr);
 	_view->activate(*this);
 	_dirty_content = true;
+	_dirty_chrome = true;
+	_dirty_frame = true;
 }
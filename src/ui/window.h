@@ -41,7 +41,12 @@ public:
 	};
 	void bring_forward(FocusRelative rel);
 	bool process(int ch);
+	bool paste(const std::string &text);
 	bool poll();
+	// Has the window drawn anything since the last time we asked?
+	bool take_painted();
+	// Draw whatever has changed since the window was last painted.
+	void paint();
 	virtual void show_dialog(std::unique_ptr<View> &&dialog) override;
 	virtual View::Priority priority() const { return _view->priority(); }
 protected:
@@ -54,11 +59,20 @@ protected:
 	void calculate_content(int &vpos, int &hpos, int &height, int &width);
 	void layout_contentwin();
 	void layout_helpbar();
-	void paint();
 	void paint_content();
 	void paint_chrome();
 	void paint_titlebar(int width);
 	void paint_helpbar(int height, int width);
+	static cchar_t cell(wchar_t ch, int style);
+	static cchar_t cell(const cchar_t *acs, int style);
+	static void put_text(
+			std::vector<cchar_t> &row,
+			int pos,
+			const std::string &text,
+			int limit,
+			int style);
+	void paint_row(
+			int v, int h, std::vector<cchar_t> &row, std::vector<cchar_t> &drawn);
 private:
 	void process_dialog(int ch);
 	void close_dialog();
@@ -84,6 +98,11 @@ private:
 	// have not yet had a chance to implement?
 	bool _dirty_content = true;
 	bool _dirty_chrome = true;
+	bool _dirty_frame = true;
+	bool _painted = false;
+	// The title bar and help bar rows as they were last drawn, so that
+	// repainting the chrome need only touch the cells which changed.
+	std::vector<std::vector<cchar_t>> _drawn;
 	// Data to display in our window chrome: this is for the use of our
 	// controller object, which can update these fields as it pleases.
 	std::string _title;
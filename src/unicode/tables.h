@@ -0,0 +1,40 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef UNICODE_TABLES_H
+#define UNICODE_TABLES_H
+
+#include <stdint.h>
+
+namespace Unicode {
+namespace Tables {
+// Character properties live in blocks of 128 bytes; the first stage picks
+// the block for a character and the second holds the blocks themselves.
+// Each byte holds the character's width in its low two bits and its
+// grapheme break class above them. See tables.py.
+const unsigned kBlockBits = 7;
+extern const uint16_t stage1[];
+extern const uint8_t stage2[];
+inline uint8_t lookup(char32_t ch) {
+	if (ch > 0x10FFFF) return 1;
+	unsigned block = stage1[ch >> kBlockBits];
+	return stage2[(block << kBlockBits) | (ch & ((1 << kBlockBits) - 1))];
+}
+} // namespace Tables
+} // namespace Unicode
+
+#endif // UNICODE_TABLES_H
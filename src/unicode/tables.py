@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+# ozette
+# Copyright (C) 2014-2016 Mars J. Saxman
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Generate the character property tables in tables.cpp from the Unicode
+# database which comes with Python. Each character gets one byte: its width
+# in the low two bits, and its grapheme cluster break class above them. The
+# bytes are stored in blocks, and identical blocks are shared.
+
+import sys
+import unicodedata
+
+BLOCK = 128
+
+# Grapheme break classes; these must match enum Unicode::Break.
+OTHER, CONTROL, EXTEND, ZWJ, REGIONAL, PREPEND, SPACING, \
+	L, V, T, LV, LVT, PICTOGRAPHIC = range(13)
+
+# The Python database doesn't include these properties, so we list them.
+PICTOGRAPHIC_RANGES = [
+	(0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C), (0x2049, 0x2049),
+	(0x2122, 0x2122), (0x2139, 0x2139), (0x2194, 0x2199), (0x21A9, 0x21AA),
+	(0x231A, 0x231B), (0x2328, 0x2328), (0x2388, 0x2388), (0x23CF, 0x23CF),
+	(0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2), (0x25AA, 0x25AB),
+	(0x25B6, 0x25B6), (0x25C0, 0x25C0), (0x25FB, 0x25FE), (0x2600, 0x2605),
+	(0x2607, 0x2612), (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712),
+	(0x2714, 0x2714), (0x2716, 0x2716), (0x271D, 0x271D), (0x2721, 0x2721),
+	(0x2728, 0x2728), (0x2733, 0x2734), (0x2744, 0x2744), (0x2747, 0x2747),
+	(0x274C, 0x274C), (0x274E, 0x274E), (0x2753, 0x2755), (0x2757, 0x2757),
+	(0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1), (0x27B0, 0x27B0),
+	(0x27BF, 0x27BF), (0x2934, 0x2935), (0x2B05, 0x2B07), (0x2B1B, 0x2B1C),
+	(0x2B50, 0x2B50), (0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D),
+	(0x3297, 0x3297), (0x3299, 0x3299), (0x1F000, 0x1F0FF),
+	(0x1F10D, 0x1F10F), (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171),
+	(0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E), (0x1F191, 0x1F19A),
+	(0x1F1AD, 0x1F1E5), (0x1F201, 0x1F20F), (0x1F21A, 0x1F21A),
+	(0x1F22F, 0x1F22F), (0x1F232, 0x1F23A), (0x1F23C, 0x1F23F),
+	(0x1F249, 0x1F3FA), (0x1F400, 0x1F53D), (0x1F546, 0x1F64F),
+	(0x1F680, 0x1F6FF), (0x1F774, 0x1F77F), (0x1F7D5, 0x1F7FF),
+	(0x1F80C, 0x1F80F), (0x1F848, 0x1F84F), (0x1F85A, 0x1F85F),
+	(0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF), (0x1F90C, 0x1F93A),
+	(0x1F93C, 0x1F945), (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD),
+]
+PREPEND_RANGES = [
+	(0x0600, 0x0605), (0x06DD, 0x06DD), (0x070F, 0x070F), (0x0890, 0x0891),
+	(0x08E2, 0x08E2), (0x0D4E, 0x0D4E), (0x110BD, 0x110BD),
+	(0x110CD, 0x110CD), (0x111C2, 0x111C3), (0x1193F, 0x1193F),
+	(0x11941, 0x11941), (0x11A3A, 0x11A3A), (0x11A84, 0x11A89),
+	(0x11D46, 0x11D46),
+]
+# Emoji skin tone modifiers extend the emoji before them.
+EXTEND_RANGES = [(0x1F3FB, 0x1F3FF), (0xE0020, 0xE007F), (0x200C, 0x200C)]
+
+def in_ranges(ch, ranges):
+	return any(lo <= ch <= hi for lo, hi in ranges)
+
+def grapheme_break(ch):
+	if ch == 0x200D: return ZWJ
+	if in_ranges(ch, EXTEND_RANGES): return EXTEND
+	if in_ranges(ch, PREPEND_RANGES): return PREPEND
+	if 0x1F1E6 <= ch <= 0x1F1FF: return REGIONAL
+	if in_ranges(ch, PICTOGRAPHIC_RANGES): return PICTOGRAPHIC
+	if 0x1100 <= ch <= 0x115F or 0xA960 <= ch <= 0xA97C: return L
+	if 0x1160 <= ch <= 0x11A7 or 0xD7B0 <= ch <= 0xD7C6: return V
+	if 0x11A8 <= ch <= 0x11FF or 0xD7CB <= ch <= 0xD7FB: return T
+	if 0xAC00 <= ch <= 0xD7A3:
+		return LV if (ch - 0xAC00) % 28 == 0 else LVT
+	cat = unicodedata.category(chr(ch))
+	if cat in ('Mn', 'Me'): return EXTEND
+	if cat == 'Mc': return SPACING
+	if cat in ('Cc', 'Zl', 'Zp') or (cat == 'Cf' and ch != 0x00AD):
+		return CONTROL
+	return OTHER
+
+def width(ch):
+	cat = unicodedata.category(chr(ch))
+	if cat in ('Mn', 'Me') or (cat == 'Cf' and ch != 0x00AD):
+		return 0
+	if 0x1160 <= ch <= 0x11FF or 0xD7B0 <= ch <= 0xD7FF:
+		return 0
+	if unicodedata.east_asian_width(chr(ch)) in ('W', 'F'):
+		return 2
+	# Unassigned code points in the ideographic planes are wide, too.
+	if 0x20000 <= ch <= 0x3FFFD:
+		return 2
+	return 1
+
+def main():
+	blocks = []
+	index = {}
+	stage1 = []
+	for base in range(0, 0x110000, BLOCK):
+		block = tuple(
+			width(ch) | (grapheme_break(ch) << 2)
+			for ch in range(base, base + BLOCK))
+		if block not in index:
+			index[block] = len(blocks)
+			blocks.append(block)
+		stage1.append(index[block])
+	out = sys.stdout
+	out.write('// Generated by tables.py from the Unicode %s database; '
+			'do not edit.\n\n' % unicodedata.unidata_version)
+	out.write('#include "unicode/tables.h"\n\n')
+	out.write('const uint16_t Unicode::Tables::stage1[%d] = {\n' % len(stage1))
+	for i in range(0, len(stage1), 16):
+		out.write('\t' + ', '.join(str(n) for n in stage1[i:i+16]) + ',\n')
+	out.write('};\n\n')
+	out.write('const uint8_t Unicode::Tables::stage2[%d] = {\n' %
+			(len(blocks) * BLOCK))
+	for block in blocks:
+		for i in range(0, BLOCK, 32):
+			out.write('\t' + ','.join(str(n) for n in block[i:i+32]) + ',\n')
+	out.write('};\n')
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,217 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "unicode/unicode.h"
+#include "unicode/tables.h"
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+const char32_t kReplacement = 0xFFFD;
+
+// May these two characters belong to the same grapheme cluster? The state
+// describes the cluster so far: whether it began with a pictographic
+// character followed only by extenders, and how many regional indicators
+// in a row it ends with.
+bool joins(Unicode::Break prev, Unicode::Break next, bool emoji, unsigned ri) {
+	using Unicode::Break;
+	if (prev == Break::Control || next == Break::Control) return false;
+	switch (prev) {
+		case Break::L:
+			if (next == Break::L || next == Break::V) return true;
+			if (next == Break::LV || next == Break::LVT) return true;
+			break;
+		case Break::LV:
+		case Break::V:
+			if (next == Break::V || next == Break::T) return true;
+			break;
+		case Break::LVT:
+		case Break::T:
+			if (next == Break::T) return true;
+			break;
+		default: break;
+	}
+	if (next == Break::Extend || next == Break::ZWJ) return true;
+	if (next == Break::SpacingMark) return true;
+	if (prev == Break::Prepend) return true;
+	if (prev == Break::ZWJ && next == Break::Pictographic && emoji) return true;
+	if (prev == Break::RegionalIndicator && next == Break::RegionalIndicator) {
+		return ri % 2 == 1;
+	}
+	return false;
+}
+
+// A character of class Other or Control always begins a new cluster, unless
+// it follows a prepended character; we can start scanning from there.
+bool starts_cluster(const char *text, size_t size, size_t pos) {
+	if (pos == 0) return true;
+	size_t next = pos;
+	auto cls = Unicode::grapheme_break(Unicode::decode(text, size, next));
+	if (cls == Unicode::Break::Control) return true;
+	if (cls != Unicode::Break::Other) return false;
+	size_t prev = Unicode::prev_char(text, size, pos);
+	cls = Unicode::grapheme_break(Unicode::decode(text, size, prev));
+	return cls != Unicode::Break::Prepend;
+}
+} // namespace
+
+Unicode::Break Unicode::grapheme_break(char32_t ch) {
+	return static_cast<Break>(Tables::lookup(ch) >> 2);
+}
+
+unsigned Unicode::width(char32_t ch) {
+	return Tables::lookup(ch) & 3;
+}
+
+char32_t Unicode::decode(const char *text, size_t size, size_t &pos) {
+	unsigned char lead = text[pos];
+	if (lead < 0x80) {
+		pos++;
+		return lead;
+	}
+	unsigned continuations = 0;
+	char32_t minimum = 0;
+	char32_t out = 0;
+	if ((lead & 0xE0) == 0xC0) {
+		continuations = 1;
+		minimum = 0x80;
+		out = lead & 0x1F;
+	} else if ((lead & 0xF0) == 0xE0) {
+		continuations = 2;
+		minimum = 0x800;
+		out = lead & 0x0F;
+	} else if ((lead & 0xF8) == 0xF0) {
+		continuations = 3;
+		minimum = 0x10000;
+		out = lead & 0x07;
+	} else {
+		pos++;
+		return kReplacement;
+	}
+	if (size - pos <= continuations) {
+		pos++;
+		return kReplacement;
+	}
+	for (unsigned i = 1; i <= continuations; ++i) {
+		unsigned char ch = text[pos + i];
+		if ((ch & 0xC0) != 0x80) {
+			pos++;
+			return kReplacement;
+		}
+		out = (out << 6) | (ch & 0x3F);
+	}
+	// Overlong encodings, surrogates, and values beyond the last plane are
+	// all malformed.
+	if (out < minimum || out > 0x10FFFF || (out >= 0xD800 && out <= 0xDFFF)) {
+		pos++;
+		return kReplacement;
+	}
+	pos += 1 + continuations;
+	return out;
+}
+
+size_t Unicode::prev_char(const char *text, size_t size, size_t pos) {
+	if (pos == 0) return 0;
+	// Back up to the nearest byte which is not a continuation. If the
+	// sequence it begins ends right here, that's the previous character;
+	// otherwise the last byte must have been a malformed sequence.
+	size_t limit = std::min(pos, (size_t)4);
+	for (size_t back = 1; back <= limit; ++back) {
+		size_t begin = pos - back;
+		if ((text[begin] & 0xC0) == 0x80) continue;
+		size_t end = begin;
+		decode(text, size, end);
+		return end == pos? begin: pos - 1;
+	}
+	return pos - 1;
+}
+
+size_t Unicode::next_cluster(
+		const char *text, size_t size, size_t pos, unsigned *cols) {
+	if (pos >= size) {
+		if (cols) *cols = 0;
+		return pos;
+	}
+	// An ASCII character followed by another ASCII character, or by nothing,
+	// is a cluster by itself.
+	if ((unsigned char)text[pos] < 0x80) {
+		if (pos + 1 == size || (unsigned char)text[pos + 1] < 0x80) {
+			if (cols) *cols = 1;
+			return pos + 1;
+		}
+	}
+	size_t next = pos;
+	char32_t ch = decode(text, size, next);
+	Break prev = grapheme_break(ch);
+	bool emoji = prev == Break::Pictographic;
+	unsigned ri = prev == Break::RegionalIndicator? 1: 0;
+	unsigned w = width(ch);
+	while (next < size) {
+		size_t after = next;
+		ch = decode(text, size, after);
+		Break cls = grapheme_break(ch);
+		if (!joins(prev, cls, emoji, ri)) break;
+		// A variation selector asks for an emoji to be drawn as a picture,
+		// which is always wide.
+		if (ch == 0xFE0F && emoji) w = 2;
+		w = std::max(w, width(ch));
+		if (cls == Break::RegionalIndicator) {
+			ri++;
+			w = 2;
+		} else if (cls != Break::Extend && cls != Break::ZWJ) {
+			emoji = cls == Break::Pictographic;
+		}
+		prev = cls;
+		next = after;
+	}
+	if (cols) *cols = std::max(w, 1U);
+	return next;
+}
+
+size_t Unicode::prev_cluster(const char *text, size_t size, size_t pos) {
+	if (pos == 0) return 0;
+	// Once again, ASCII is easy.
+	if ((unsigned char)text[pos - 1] < 0x80) {
+		if (pos == 1 || (unsigned char)text[pos - 2] < 0x80) return pos - 1;
+	}
+	// Back up to a place where a cluster must begin, then work forward.
+	size_t begin = prev_char(text, size, pos);
+	while (!starts_cluster(text, size, begin)) {
+		begin = prev_char(text, size, begin);
+	}
+	for (;;) {
+		size_t next = next_cluster(text, size, begin);
+		if (next >= pos) return begin;
+		begin = next;
+	}
+}
+
+bool Unicode::ascii(const char *text, size_t size) {
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= size; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+		if (_mm_movemask_epi8(chunk)) return false;
+	}
+#endif
+	for (; i < size; ++i) {
+		if (text[i] & 0x80) return false;
+	}
+	return true;
+}
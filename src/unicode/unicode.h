@@ -0,0 +1,57 @@
+// ozette
+// Copyright (C) 2014-2016 Mars J. Saxman
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef UNICODE_UNICODE_H
+#define UNICODE_UNICODE_H
+
+#include <stddef.h>
+
+// Everything the editor needs to know about UTF-8 text: how to decode it,
+// how wide each character is on screen, and where the boundaries between
+// user-perceived characters fall. The property tables are generated from
+// the Unicode database by tables.py.
+namespace Unicode {
+// Grapheme cluster break classes, as defined by UAX #29.
+enum class Break {
+	Other, Control, Extend, ZWJ, RegionalIndicator, Prepend, SpacingMark,
+	L, V, T, LV, LVT, Pictographic
+};
+Break grapheme_break(char32_t ch);
+
+// How many columns does this character occupy? Combining marks and other
+// invisible characters take up none; East Asian wide characters take two.
+unsigned width(char32_t ch);
+
+// Decode the character beginning at this offset and advance past it.
+// A malformed sequence decodes as U+FFFD and occupies a single byte.
+char32_t decode(const char *text, size_t size, size_t &pos);
+// Where does the character before this offset begin?
+size_t prev_char(const char *text, size_t size, size_t pos);
+
+// A grapheme cluster is what the user thinks of as a single character: a
+// base character with its combining marks, an emoji sequence, or a flag.
+// Find the end of the cluster beginning at this offset and, optionally, the
+// number of columns it occupies, which is never less than one.
+size_t next_cluster(const char *text, size_t size, size_t pos, unsigned *cols = nullptr);
+// Where does the cluster before this offset begin?
+size_t prev_cluster(const char *text, size_t size, size_t pos);
+
+// Is this text entirely 7-bit ASCII?
+bool ascii(const char *text, size_t size);
+} // namespace Unicode
+
+#endif // UNICODE_UNICODE_H